@@ -0,0 +1,90 @@
+#ifndef ACTIVE_LINE_H
+#define ACTIVE_LINE_H
+
+#include "grapheme.h"
+#include "terminal_parser.h"
+#include "utf8_decoder.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+// The line currently being written in history mode. Text is kept as
+// attribute-homogeneous segments and handed over to the scrollback once a
+// newline arrives.
+//
+// The line has a cursor column, in cells (see utl::char_width). Text is
+// written at the cursor, so `\r` followed by new text overwrites the line
+// in place the way progress bars expect, and the line never grows past its
+// widest redraw. Overwriting half of a wide cluster blanks the other half,
+// as on the screen.
+//
+// Segments double as rope chunks: none grows past CHUNK_BYTES, so a huge
+// line with no newline is many small strings rather than one big one. A
+// sparse wrap index records where every WRAP_STRIDE-th visual row starts;
+// appending only extends it, so finding the last rows of a 100 MB line
+// walks at most one stride instead of the whole line.
+class ActiveLine {
+public:
+    static constexpr size_t CHUNK_BYTES = 4096;
+    static constexpr size_t WRAP_STRIDE = 64;   // rows per index entry
+
+    struct Position {
+        size_t segment = 0;
+        size_t byte = 0;
+        size_t cell = 0;   // cells before this position
+    };
+
+    // Applies a line-editing action (text, \r, backspace, EL, horizontal
+    // cursor moves). Newlines and screen clears are left to the owner,
+    // which decides where lines go.
+    void apply(const TerminalAction& a);
+
+    // `bytes` may end inside a UTF-8 sequence; the rest is expected in the
+    // next write.
+    void write(const std::string& bytes, const TerminalAttributes& attr);
+    void carriage_return() { col = 0; }
+    void move(int n);
+    void erase(int mode);
+    void clear();
+
+    const ParsedLine& line() const { return current; }
+    bool empty() const { return current.segments.empty(); }
+    size_t cursor() const { return col; }
+    size_t length() const { return len; }
+
+    // Visual rows at `cols` cells per row, a wide cluster moving whole
+    // to the next row (the renderer's rule for everything but Devanagari
+    // runs).
+    size_t rows(size_t cols) const;
+    Position row_start(size_t cols, size_t row) const;
+    // Cells from `from` to the cursor, or nullopt when the cursor sits
+    // before it (on an earlier wrap row after a \r).
+    std::optional<size_t> cursor_offset(const Position& from) const {
+        if (col < from.cell)
+            return std::nullopt;
+        return col - from.cell;
+    }
+
+private:
+    ParsedLine current;
+    size_t len = 0;   // cells in `current`
+    size_t col = 0;   // may sit past the end; gaps are padded on write
+    utl::Utf8Decoder utf8;   // carries sequences split across writes
+
+    mutable size_t wrap_cols = 0;
+    mutable std::vector<Position> wrap;   // start of rows 0, STRIDE, 2*STRIDE...
+    mutable size_t wrap_rows = 0;         // rows in the indexed prefix
+    mutable Position scan;                // end of the indexed prefix
+    mutable size_t scan_cells = 0;        // cells used in the last row
+    mutable utl::GraphemeBreaker scan_breaker;   // clusters open at `scan`
+
+    void index(size_t cols) const;
+    void invalidate(size_t cell);
+
+    void append(const std::string& text, const TerminalAttributes& attr);
+    std::vector<Segment> cut(size_t at);
+    static void drop_front(std::vector<Segment>& segments, size_t n);
+};
+
+#endif // ACTIVE_LINE_H
@@ -0,0 +1,96 @@
+#ifndef FONT_FALLBACK_H
+#define FONT_FALLBACK_H
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Chooses the font that draws a code point.
+//
+// Fonts form a chain: the main font first, then the configured fallbacks
+// in order, then (when built with fontconfig) fonts discovered for code
+// points none of those cover. A code point goes to the first font whose
+// character map contains it. Fallback files are opened only when a code
+// point reaches them, and each font's coverage is read from its character
+// map once, when it is opened.
+//
+// Decisions are cached per code point in pages of 256 entries, so after
+// the first lookup font_for() is two array indexings.
+class FontFallback {
+public:
+  // Opens font `index` of the chain from `path` (face `face_index` of a
+  // collection), returning nullptr if it cannot be used.
+  using Opener = std::function<FT_Face(size_t index, const std::string &path,
+                                       long face_index)>;
+
+  static constexpr size_t MAX_FONTS = 254;
+
+  FontFallback(std::vector<std::string> paths, Opener open);
+
+  // Chain index of the font for `cp`; 0 (the main font's notdef glyph)
+  // when no font has it.
+  size_t font_for(char32_t cp) {
+    if (cp >= 0x110000)
+      return 0;
+    const Page *page = cache[cp >> 8].get();
+    uint8_t entry = page ? (*page)[cp & 0xFF] : 0;
+    return entry ? entry - 1 : resolve(cp);
+  }
+
+  // Whether fonts missing from the chain are looked up with fontconfig.
+  void set_discovery(bool on) { discovery = on; }
+
+  size_t size() const { return fonts.size(); }
+
+private:
+  static constexpr char32_t PAGES = 0x110000 >> 8;
+
+  // One bit per code point in the font's character map, in 256-bit pages
+  // allocated only where the font has characters.
+  class Coverage {
+  public:
+    void build(FT_Face face);
+    bool has(char32_t cp) const {
+      if (cp >= 0x110000 || page_of[cp >> 8] == 0)
+        return false;
+      const Bits &bits = pages[page_of[cp >> 8] - 1];
+      return bits[(cp & 0xFF) >> 6] >> (cp & 63) & 1;
+    }
+
+  private:
+    using Bits = std::array<uint64_t, 4>;
+    std::vector<uint16_t> page_of;   // page number + 1, 0 for none
+    std::vector<Bits> pages;
+  };
+
+  struct Font {
+    Font(std::string path, long face_index = 0)
+        : path(std::move(path)), face_index(face_index) {}
+
+    std::string path;
+    long face_index = 0;
+    bool opened = false;   // open was attempted
+    bool usable = false;
+    Coverage coverage;
+  };
+
+  // Chain index + 1 per code point, 0 for not yet decided.
+  using Page = std::array<uint8_t, 256>;
+
+  std::vector<Font> fonts;
+  std::vector<std::unique_ptr<Page>> cache;
+  Opener open;
+  bool discovery = true;
+
+  size_t resolve(char32_t cp);
+  bool covers(size_t index, char32_t cp);
+  size_t discover(char32_t cp);
+  void remember(char32_t cp, size_t index);
+};
+
+#endif // FONT_FALLBACK_H
@@ -0,0 +1,55 @@
+#ifndef FONT_FILE_H
+#define FONT_FILE_H
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// A font file mapped read-only into memory.
+//
+// FreeType faces and HarfBuzz blobs are made from the mapping instead of
+// reading the file, so every face of a font, on any thread and in any
+// window, shares the same pages. A file is mapped once per process: open()
+// hands out the existing mapping while anything still holds it.
+class FontFile {
+public:
+  ~FontFile();
+  FontFile(const FontFile &) = delete;
+  FontFile &operator=(const FontFile &) = delete;
+
+  // The mapping of `path`, or nullptr if it cannot be read.
+  static std::shared_ptr<const FontFile> open(const std::string &path);
+
+  const unsigned char *data() const { return bytes; }
+  size_t size() const { return length; }
+  const std::string &path() const { return file; }
+
+  // Hash of the file's contents. Reading the whole file takes a while for
+  // large fonts, so it is done on first use and kept with the mapping.
+  uint64_t hash() const;
+
+  // A face of the font in `library`; the mapping must outlive it.
+  FT_Face new_face(FT_Library library, long face_index) const;
+
+private:
+  FontFile(std::string path, const unsigned char *bytes, size_t length)
+      : file(std::move(path)), bytes(bytes), length(length) {}
+
+  std::string file;
+  const unsigned char *bytes;
+  size_t length;
+
+  mutable std::once_flag hashed;
+  mutable uint64_t content_hash = 0;
+};
+
+// The FreeType library for faces used on the render thread: shaping,
+// metrics and coverage. Created on first use and kept for the life of the
+// process. Rasterizer workers have their own.
+FT_Library shared_ft_library();
+
+#endif // FONT_FILE_H
@@ -0,0 +1,141 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Structure to hold character information
+struct Character {
+  unsigned int texture_id; // Atlas page holding the glyph, 0 for none
+  int width;               // Width of the glyph
+  int height;              // Height of the glyph
+  int bearing_x;           // Horizontal offset from baseline to leftmost
+  int bearing_y;           // Vertical offset from baseline to topmost
+  unsigned int advance;    // Horizontal offset to advance to next glyph
+  float u0, v0, u1, v1;    // Texture coordinates of the glyph in its page
+};
+
+// A glyph rendered off the GL thread, rows packed without padding.
+struct GlyphBitmap {
+  unsigned int font_index;
+  unsigned int glyph_id;
+  int width;
+  int rows;
+  int left;
+  int top;
+  unsigned int advance;
+  std::vector<unsigned char> pixels;
+};
+
+// Rasterized glyphs packed into shared textures.
+//
+// Glyph bitmaps go onto square atlas pages in shelves (rows as tall as
+// their tallest glyph). Pages are the unit of eviction: once the pages
+// would exceed the memory budget, the least recently drawn page is
+// cleared and refilled, and every glyph on it is rasterized again the next
+// time it is needed. Pages drawn from in the current frame are never
+// evicted; if a single frame needs more than the budget, pages are added
+// and the surplus is released by next_frame().
+//
+// Glyphs are found by (font, glyph id) in an open-addressing table. An
+// evicted page gets a new generation number instead of having its entries
+// removed; entries from an older generation read as misses and are
+// dropped when the table grows.
+//
+// Bitmaps arrive in batches; a batch is copied into one pixel buffer
+// object and uploaded from there, so the driver gets a single transfer
+// per frame instead of one per glyph.
+class GlyphAtlas {
+public:
+  static constexpr int PAGE_SIZE = 1024;
+  static constexpr size_t PAGE_BYTES = size_t{PAGE_SIZE} * PAGE_SIZE;
+  static constexpr size_t DEFAULT_BUDGET = 32 * PAGE_BYTES;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;      // glyphs that had to be rasterized
+    uint64_t evictions = 0;   // pages cleared to make room
+    size_t pages = 0;         // pages currently allocated
+  };
+
+  GlyphAtlas() = default;
+  ~GlyphAtlas();
+  GlyphAtlas(const GlyphAtlas &) = delete;
+  GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+  // Texture memory to stay within, rounded down to whole pages (at least
+  // one).
+  void set_budget(size_t bytes);
+
+  // The glyph if it is in the atlas, marking its page as used this frame.
+  const Character *find(unsigned int font_index, unsigned int glyph_id);
+
+  // Places the bitmaps and uploads them together.
+  void insert(const std::vector<GlyphBitmap> &bitmaps);
+
+  // (font, glyph id) of every glyph held, for rendering them again at
+  // another size.
+  std::vector<std::pair<unsigned int, unsigned int>> glyphs() const;
+
+  // Starts a new frame and gives back pages beyond the budget.
+  void next_frame();
+
+  const Stats &stats() const { return counters; }
+
+private:
+  static constexpr uint16_t NO_PAGE = 0xFFFF;
+  static constexpr int PADDING = 1;   // keeps linear filtering off neighbours
+
+  struct Shelf {
+    int y;
+    int height;
+    int x;   // next free column
+  };
+  struct Page {
+    unsigned int texture = 0;   // 0 while released
+    std::vector<Shelf> shelves;
+    int next_y = 0;             // top of the unused space below the shelves
+    uint32_t generation = 0;
+    uint32_t used = 0;          // frame it was last drawn from
+  };
+  struct Upload {
+    const GlyphBitmap *bitmap;
+    unsigned int texture;
+    int x, y;
+  };
+  struct Slot {
+    uint64_t key = 0;   // 0 for empty
+    uint16_t page = NO_PAGE;
+    uint32_t generation = 0;
+    Character glyph{};
+  };
+
+  std::vector<Page> pages;
+  std::vector<Slot> slots;   // size is a power of two
+  size_t filled = 0;
+  size_t max_pages = DEFAULT_BUDGET / PAGE_BYTES;
+  uint32_t frame = 1;
+  Stats counters;
+  unsigned int pbo = 0;
+  std::vector<Upload> uploads;
+
+  static uint64_t key_of(unsigned int font_index, unsigned int glyph_id) {
+    return (uint64_t{font_index} + 1) << 32 | glyph_id;
+  }
+  bool live(const Slot &slot) const {
+    return slot.page == NO_PAGE || slot.generation == pages[slot.page].generation;
+  }
+
+  void place_glyph(const GlyphBitmap &bitmap);
+  void upload();
+  Slot &slot_for(uint64_t key);
+  void grow();
+  bool place(Page &page, int w, int h, int &x, int &y);
+  size_t page_for(int w, int h, int &x, int &y);
+  void open_page(Page &page);
+  void clear_page(Page &page);
+};
+
+#endif // GLYPH_ATLAS_H
@@ -0,0 +1,85 @@
+#ifndef GLYPH_DISK_CACHE_H
+#define GLYPH_DISK_CACHE_H
+
+#include "font_file.h"
+#include "glyph_atlas.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Rasterized glyphs of one font kept across runs.
+//
+// The file lives under $XDG_CACHE_HOME/sita (~/.cache/sita without it)
+// and is named after the renderer version, a hash of the font file's
+// contents, the pixel size and the bitmap kind (coverage or distance
+// field), so a changed font or size never reads stale bitmaps. It is
+// mapped read-only at startup; a glyph found there is copied out without
+// FreeType. Glyphs rasterized during the run are added by rewriting the
+// file on exit.
+//
+// Layout: a Header, `count` Entries sorted by glyph id, then the pixel
+// rows of every glyph, packed.
+class GlyphDiskCache {
+public:
+  // Bump whenever rasterization changes (load flags, hinting, format).
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t MAX_GLYPHS = 8192;
+
+  GlyphDiskCache() = default;
+  ~GlyphDiskCache();
+  GlyphDiskCache(const GlyphDiskCache &) = delete;
+  GlyphDiskCache &operator=(const GlyphDiskCache &) = delete;
+
+  // Maps the cache file for the font, if one was written before.
+  bool open(const FontFile &font, long face_index, unsigned int pixel_size,
+            bool sdf);
+  void close();
+
+  // Copies glyph `glyph_id` out of the file; `out.font_index` is left as
+  // it is.
+  bool find(unsigned int glyph_id, GlyphBitmap &out) const;
+
+  // Keeps a newly rasterized glyph for save().
+  void remember(const GlyphBitmap &bitmap);
+
+  // Rewrites the file with the mapped glyphs plus the remembered ones.
+  bool save();
+
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t pixel_size;
+    uint64_t font_hash;
+    uint32_t count;
+    uint32_t flags;   // FLAG_SDF
+  };
+  static constexpr uint32_t FLAG_SDF = 1;
+  struct Entry {
+    uint32_t glyph_id;
+    int32_t width;
+    int32_t rows;
+    int32_t left;
+    int32_t top;
+    uint32_t advance;
+    uint64_t offset;   // of the pixels, from the start of the file
+  };
+
+  std::string path;
+  uint64_t font_hash = 0;
+  unsigned int pixel_size = 0;
+  uint32_t flags = 0;
+
+  const uint8_t *map = nullptr;
+  size_t map_size = 0;
+  const Entry *entries = nullptr;
+  size_t count = 0;
+
+  std::vector<GlyphBitmap> added;
+
+  const Entry *lookup(unsigned int glyph_id) const;
+  bool in_bounds(const Entry &e) const;
+};
+
+#endif // GLYPH_DISK_CACHE_H
@@ -0,0 +1,96 @@
+#ifndef GLYPH_RASTERIZER_H
+#define GLYPH_RASTERIZER_H
+
+#include "font_file.h"
+#include "glyph_atlas.h"
+#include "glyph_disk_cache.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Renders glyph bitmaps on worker threads.
+//
+// FreeType faces are not safe to share between threads, so every worker
+// opens its own face for each font, the first time it gets a glyph from
+// that font. The faces are made from the font's shared mapping, so this
+// costs no file reads. The render thread asks for missing glyphs with
+// request(), draws without them, and picks up the finished bitmaps with
+// collect() at the start of a later frame.
+//
+// In distance-field mode glyphs are rendered as signed distance fields
+// (FreeType's SDF renderer) instead of coverage: one bitmap per glyph then
+// draws crisply at any scale, with the edge found in the shader.
+//
+// Each font also has a GlyphDiskCache. A requested glyph found there is
+// finished at once, without a worker; glyphs the workers render are added
+// to it and written out when the rasterizer is destroyed, unless it was
+// cancelled.
+class GlyphRasterizer {
+public:
+  explicit GlyphRasterizer(bool sdf = false,
+                           unsigned int threads = default_threads());
+  ~GlyphRasterizer();
+  GlyphRasterizer(const GlyphRasterizer &) = delete;
+  GlyphRasterizer &operator=(const GlyphRasterizer &) = delete;
+
+  static unsigned int default_threads();
+
+  // Makes font `index` available to the workers and maps its disk cache.
+  void add_font(size_t index, std::shared_ptr<const FontFile> file,
+                long face_index, unsigned int pixel_size);
+
+  // Queues a glyph unless it is already queued or being rendered.
+  void request(unsigned int font_index, unsigned int glyph_id);
+
+  // Moves bitmaps finished since the last call to the end of `out`.
+  void collect(std::vector<GlyphBitmap> &out);
+
+  // Like collect(), after waiting for every queued glyph.
+  void drain(std::vector<GlyphBitmap> &out);
+
+  // Whether requested glyphs are still to be collected.
+  bool busy() const { return !in_flight.empty(); }
+
+  // Drops queued glyphs and leaves the disk caches unwritten, for a
+  // rasterizer replaced before it finished.
+  void cancel();
+
+private:
+  struct Job {
+    unsigned int font_index;
+    unsigned int glyph_id;
+  };
+  struct FontSource {
+    std::shared_ptr<const FontFile> file;
+    long face_index = 0;
+    unsigned int pixel_size = 0;
+  };
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  std::deque<Job> jobs;
+  std::vector<GlyphBitmap> finished;
+  std::vector<FontSource> fonts;
+  std::vector<std::unique_ptr<GlyphDiskCache>> disk;   // by font index
+  size_t running = 0;   // jobs taken by workers and not yet finished
+  bool stopping = false;
+  bool cancelled = false;
+  const bool sdf;
+
+  // Render thread only: glyphs requested and not yet collected.
+  std::unordered_set<uint64_t> in_flight;
+
+  std::vector<std::thread> workers;
+
+  void take_finished(std::vector<GlyphBitmap> &out);
+  void work();
+};
+
+#endif // GLYPH_RASTERIZER_H
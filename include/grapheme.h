@@ -0,0 +1,389 @@
+#ifndef GRAPHEME_H
+#define GRAPHEME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "char_width.h"
+#include "unicode_table.h"
+#include "utils.h"
+
+// Extended grapheme cluster boundaries (UAX #29, Unicode 15.1 rules).
+//
+// Grapheme_Cluster_Break values, Extended_Pictographic and the Indic
+// conjunct classes are packed into one byte per code point and looked up
+// through a compile-time two-level table. GraphemeBreaker is fed one code
+// point at a time, so clusters can be found as bytes arrive from the PTY.
+
+namespace utl {
+
+enum GraphemeProp : uint8_t {
+  GB_OTHER = 0,
+  GB_CR,
+  GB_LF,
+  GB_CONTROL,
+  GB_EXTEND,
+  GB_ZWJ,
+  GB_REGIONAL_INDICATOR,
+  GB_PREPEND,
+  GB_SPACING_MARK,
+  GB_L,
+  GB_V,
+  GB_T,
+  GB_LV,
+  GB_LVT,
+
+  GB_MASK = 0x0F,
+  GB_EXT_PICT = 0x10,        // Extended_Pictographic
+  GB_INCB_CONSONANT = 0x20,  // Indic_Conjunct_Break=Consonant
+  GB_INCB_LINKER = 0x40,     // Indic_Conjunct_Break=Linker
+  GB_INCB_EXTEND = 0x80,     // Indic_Conjunct_Break=Extend
+};
+
+namespace grapheme_detail {
+
+using ucd::Range;
+
+// Spacing combining marks (Mc) that do not break from their base.
+inline constexpr Range spacing_mark[] = {
+    {0x0903, 0x0903},   {0x093B, 0x093B},   {0x093E, 0x0940},   {0x0949, 0x094C},
+    {0x094E, 0x094F},   {0x0982, 0x0983},   {0x09BF, 0x09C0},   {0x09C7, 0x09C8},
+    {0x09CB, 0x09CC},   {0x0A03, 0x0A03},   {0x0A3E, 0x0A40},   {0x0A83, 0x0A83},
+    {0x0ABE, 0x0AC0},   {0x0AC9, 0x0AC9},   {0x0ACB, 0x0ACC},   {0x0B02, 0x0B03},
+    {0x0B40, 0x0B40},   {0x0B47, 0x0B48},   {0x0B4B, 0x0B4C},   {0x0BBF, 0x0BBF},
+    {0x0BC1, 0x0BC2},   {0x0BC6, 0x0BC8},   {0x0BCA, 0x0BCC},   {0x0C01, 0x0C03},
+    {0x0C41, 0x0C44},   {0x0C82, 0x0C83},   {0x0CBE, 0x0CBE},   {0x0CC0, 0x0CC1},
+    {0x0CC3, 0x0CC4},   {0x0CC7, 0x0CC8},   {0x0CCA, 0x0CCB},   {0x0CF3, 0x0CF3},
+    {0x0D02, 0x0D03},   {0x0D3F, 0x0D40},   {0x0D46, 0x0D48},   {0x0D4A, 0x0D4C},
+    {0x0D82, 0x0D83},   {0x0DD0, 0x0DD1},   {0x0DD8, 0x0DDE},   {0x0DF2, 0x0DF3},
+    {0x0E33, 0x0E33},   {0x0EB3, 0x0EB3},   {0x0F3E, 0x0F3F},   {0x0F7F, 0x0F7F},
+    {0x1031, 0x1031},   {0x103B, 0x103C},   {0x1056, 0x1057},   {0x1084, 0x1084},
+    {0x1715, 0x1715},   {0x1734, 0x1734},   {0x17B6, 0x17B6},   {0x17BE, 0x17C5},
+    {0x17C7, 0x17C8},   {0x1923, 0x1926},   {0x1929, 0x192B},   {0x1930, 0x1931},
+    {0x1933, 0x1938},   {0x1A19, 0x1A1A},   {0x1A55, 0x1A55},   {0x1A57, 0x1A57},
+    {0x1A6D, 0x1A72},   {0x1B04, 0x1B04},   {0x1B3B, 0x1B3B},   {0x1B3D, 0x1B41},
+    {0x1B43, 0x1B44},   {0x1B82, 0x1B82},   {0x1BA1, 0x1BA1},   {0x1BA6, 0x1BA7},
+    {0x1BAA, 0x1BAA},   {0x1BE7, 0x1BE7},   {0x1BEA, 0x1BEC},   {0x1BEE, 0x1BEE},
+    {0x1BF2, 0x1BF3},   {0x1C24, 0x1C2B},   {0x1C34, 0x1C35},   {0x1CE1, 0x1CE1},
+    {0x1CF7, 0x1CF7},   {0xA823, 0xA824},   {0xA827, 0xA827},   {0xA880, 0xA881},
+    {0xA8B4, 0xA8C3},   {0xA952, 0xA953},   {0xA983, 0xA983},   {0xA9B4, 0xA9B5},
+    {0xA9BA, 0xA9BB},   {0xA9BE, 0xA9C0},   {0xAA2F, 0xAA30},   {0xAA33, 0xAA34},
+    {0xAA4D, 0xAA4D},   {0xAAEB, 0xAAEB},   {0xAAEE, 0xAAEF},   {0xAAF5, 0xAAF5},
+    {0xABE3, 0xABE4},   {0xABE6, 0xABE7},   {0xABE9, 0xABEA},   {0xABEC, 0xABEC},
+    {0x11000, 0x11000}, {0x11002, 0x11002}, {0x11082, 0x11082}, {0x110B0, 0x110B2},
+    {0x110B7, 0x110B8}, {0x1112C, 0x1112C}, {0x11145, 0x11146}, {0x11182, 0x11182},
+    {0x111B3, 0x111B5}, {0x111BF, 0x111C0}, {0x111CE, 0x111CE}, {0x1122C, 0x1122E},
+    {0x11232, 0x11233}, {0x11235, 0x11235}, {0x112E0, 0x112E2}, {0x11302, 0x11303},
+    {0x1133F, 0x1133F}, {0x11341, 0x11344}, {0x11347, 0x11348}, {0x1134B, 0x1134D},
+    {0x11362, 0x11363}, {0x11435, 0x11437}, {0x11440, 0x11441}, {0x11445, 0x11445},
+    {0x114B1, 0x114B2}, {0x114B9, 0x114B9}, {0x114BB, 0x114BC}, {0x114BE, 0x114BE},
+    {0x114C1, 0x114C1}, {0x115B0, 0x115B1}, {0x115B8, 0x115BB}, {0x115BE, 0x115BE},
+    {0x11630, 0x11632}, {0x1163B, 0x1163C}, {0x1163E, 0x1163E}, {0x116AC, 0x116AC},
+    {0x116AE, 0x116AF}, {0x116B6, 0x116B6}, {0x11726, 0x11726}, {0x1182C, 0x1182E},
+    {0x11838, 0x11838}, {0x11931, 0x11935}, {0x11937, 0x11938}, {0x1193D, 0x1193D},
+    {0x11940, 0x11940}, {0x11942, 0x11942}, {0x119D1, 0x119D3}, {0x119DC, 0x119DF},
+    {0x119E4, 0x119E4}, {0x11A39, 0x11A39}, {0x11A57, 0x11A58}, {0x11A97, 0x11A97},
+    {0x11C2F, 0x11C2F}, {0x11C3E, 0x11C3E}, {0x11CA9, 0x11CA9}, {0x11CB1, 0x11CB1},
+    {0x11CB4, 0x11CB4}, {0x11D8A, 0x11D8E}, {0x11D93, 0x11D94}, {0x11D96, 0x11D96},
+    {0x11EF5, 0x11EF6}, {0x11F03, 0x11F03}, {0x11F34, 0x11F35}, {0x11F3E, 0x11F3F},
+    {0x11F41, 0x11F41}, {0x16F51, 0x16F87}, {0x16FF0, 0x16FF1}, {0x1D166, 0x1D166},
+    {0x1D16D, 0x1D16D},
+};
+
+// Spacing marks and modifiers that are nonetheless Grapheme_Extend.
+inline constexpr Range extra_extend[] = {
+    {0x09BE, 0x09BE},   {0x09D7, 0x09D7},   {0x0B3E, 0x0B3E},   {0x0B57, 0x0B57},
+    {0x0BBE, 0x0BBE},   {0x0BD7, 0x0BD7},   {0x0CC2, 0x0CC2},   {0x0CD5, 0x0CD6},
+    {0x0D3E, 0x0D3E},   {0x0D57, 0x0D57},   {0x0DCF, 0x0DCF},   {0x0DDF, 0x0DDF},
+    {0x1B35, 0x1B35},   {0x200C, 0x200C},   {0x302E, 0x302F},   {0xFF9E, 0xFF9F},
+    {0x1133E, 0x1133E}, {0x11357, 0x11357}, {0x114B0, 0x114B0}, {0x114BD, 0x114BD},
+    {0x115AF, 0x115AF}, {0x11930, 0x11930}, {0x1D165, 0x1D165}, {0x1D16E, 0x1D172},
+    {0x1F3FB, 0x1F3FF},
+};
+
+inline constexpr Range prepend[] = {
+    {0x0600, 0x0605},   {0x06DD, 0x06DD},   {0x070F, 0x070F},   {0x0890, 0x0891},
+    {0x08E2, 0x08E2},   {0x0D4E, 0x0D4E},   {0x110BD, 0x110BD}, {0x110CD, 0x110CD},
+    {0x111C2, 0x111C3}, {0x1193F, 0x1193F}, {0x11941, 0x11941}, {0x11A3A, 0x11A3A},
+    {0x11A84, 0x11A89}, {0x11D46, 0x11D46}, {0x11F02, 0x11F02},
+};
+
+inline constexpr Range control[] = {
+    {0x0000, 0x0009},   {0x000B, 0x000C},   {0x000E, 0x001F},   {0x007F, 0x009F},
+    {0x00AD, 0x00AD},   {0x061C, 0x061C},   {0x180E, 0x180E},   {0x200B, 0x200B},
+    {0x200E, 0x200F},   {0x2028, 0x202E},   {0x2060, 0x206F},   {0xFEFF, 0xFEFF},
+    {0xFFF0, 0xFFFB},   {0x13430, 0x1343F}, {0x1BCA0, 0x1BCA3}, {0x1D173, 0x1D17A},
+    {0xE0000, 0xE001F}, {0xE0080, 0xE00FF}, {0xE01F0, 0xE0FFF},
+};
+
+inline constexpr Range cr[] = {{0x000D, 0x000D}};
+inline constexpr Range lf[] = {{0x000A, 0x000A}};
+inline constexpr Range zwj[] = {{0x200D, 0x200D}};
+inline constexpr Range regional_indicator[] = {{0x1F1E6, 0x1F1FF}};
+
+inline constexpr Range hangul_l[] = {{0x1100, 0x115F}, {0xA960, 0xA97C}};
+inline constexpr Range hangul_v[] = {{0x1160, 0x11A7}, {0xD7B0, 0xD7C6}};
+inline constexpr Range hangul_t[] = {{0x11A8, 0x11FF}, {0xD7CB, 0xD7FB}};
+
+inline constexpr Range extended_pictographic[] = {
+    {0x00A9, 0x00A9},   {0x00AE, 0x00AE},   {0x203C, 0x203C},   {0x2049, 0x2049},
+    {0x2122, 0x2122},   {0x2139, 0x2139},   {0x2194, 0x2199},   {0x21A9, 0x21AA},
+    {0x231A, 0x231B},   {0x2328, 0x2328},   {0x2388, 0x2388},   {0x23CF, 0x23CF},
+    {0x23E9, 0x23F3},   {0x23F8, 0x23FA},   {0x24C2, 0x24C2},   {0x25AA, 0x25AB},
+    {0x25B6, 0x25B6},   {0x25C0, 0x25C0},   {0x25FB, 0x25FE},   {0x2600, 0x2605},
+    {0x2607, 0x2612},   {0x2614, 0x2685},   {0x2690, 0x2705},   {0x2708, 0x2712},
+    {0x2714, 0x2714},   {0x2716, 0x2716},   {0x271D, 0x271D},   {0x2721, 0x2721},
+    {0x2728, 0x2728},   {0x2733, 0x2734},   {0x2744, 0x2744},   {0x2747, 0x2747},
+    {0x274C, 0x274C},   {0x274E, 0x274E},   {0x2753, 0x2755},   {0x2757, 0x2757},
+    {0x2763, 0x2767},   {0x2795, 0x2797},   {0x27A1, 0x27A1},   {0x27B0, 0x27B0},
+    {0x27BF, 0x27BF},   {0x2934, 0x2935},   {0x2B05, 0x2B07},   {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x3030, 0x3030},   {0x303D, 0x303D},
+    {0x3297, 0x3297},   {0x3299, 0x3299},   {0x1F000, 0x1F0FF}, {0x1F10D, 0x1F10F},
+    {0x1F12F, 0x1F12F}, {0x1F16C, 0x1F171}, {0x1F17E, 0x1F17F}, {0x1F18E, 0x1F18E},
+    {0x1F191, 0x1F19A}, {0x1F1AD, 0x1F1E5}, {0x1F201, 0x1F20F}, {0x1F21A, 0x1F21A},
+    {0x1F22F, 0x1F22F}, {0x1F232, 0x1F23A}, {0x1F23C, 0x1F23F}, {0x1F249, 0x1F3FA},
+    {0x1F400, 0x1F53D}, {0x1F546, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F774, 0x1F77F},
+    {0x1F7D5, 0x1F7FF}, {0x1F80C, 0x1F80F}, {0x1F848, 0x1F84F}, {0x1F85A, 0x1F85F},
+    {0x1F888, 0x1F88F}, {0x1F8AE, 0x1F8FF}, {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945},
+    {0x1F947, 0x1FAFF}, {0x1FC00, 0x1FFFD},
+};
+
+// Indic_Conjunct_Break for the scripts with a conjunct-forming virama.
+inline constexpr Range incb_consonant[] = {
+    {0x0915, 0x0939},   {0x0958, 0x095F},   {0x0978, 0x097F},   {0x0995, 0x09A8},
+    {0x09AA, 0x09B0},   {0x09B2, 0x09B2},   {0x09B6, 0x09B9},   {0x09DC, 0x09DD},
+    {0x09DF, 0x09DF},   {0x09F0, 0x09F1},   {0x0A95, 0x0AA8},   {0x0AAA, 0x0AB0},
+    {0x0AB2, 0x0AB3},   {0x0AB5, 0x0AB9},   {0x0AF9, 0x0AF9},   {0x0B15, 0x0B28},
+    {0x0B2A, 0x0B30},   {0x0B32, 0x0B33},   {0x0B35, 0x0B39},   {0x0B5C, 0x0B5D},
+    {0x0B5F, 0x0B5F},   {0x0B71, 0x0B71},   {0x0C15, 0x0C28},   {0x0C2A, 0x0C39},
+    {0x0C58, 0x0C5A},   {0x0D15, 0x0D3A},
+};
+
+inline constexpr Range incb_linker[] = {
+    {0x094D, 0x094D},   {0x09CD, 0x09CD},   {0x0ACD, 0x0ACD},   {0x0B4D, 0x0B4D},
+    {0x0C4D, 0x0C4D},   {0x0D4D, 0x0D4D},
+};
+
+// Nuktas and Vedic stress marks; other InCB=Extend marks are rare inside
+// conjuncts.
+inline constexpr Range incb_extend[] = {
+    {0x093C, 0x093C},   {0x0951, 0x0954},   {0x09BC, 0x09BC},   {0x0ABC, 0x0ABC},
+    {0x0B3C, 0x0B3C},   {0x0C3C, 0x0C3C},
+};
+
+static_assert(ucd::sorted(spacing_mark) && ucd::sorted(extra_extend) &&
+              ucd::sorted(prepend) && ucd::sorted(control) &&
+              ucd::sorted(extended_pictographic) && ucd::sorted(incb_consonant));
+
+// Later layers win: zero-width characters default to Extend, format
+// characters among them become Control again, and so on.
+inline constexpr ucd::Builder built = ucd::build(
+    std::array{
+        ucd::layer(width_detail::zero_width, GB_EXTEND),
+        ucd::layer(extra_extend, GB_EXTEND),
+        ucd::layer(spacing_mark, GB_SPACING_MARK),
+        ucd::layer(prepend, GB_PREPEND),
+        ucd::layer(control, GB_CONTROL),
+        ucd::layer(cr, GB_CR),
+        ucd::layer(lf, GB_LF),
+        ucd::layer(zwj, GB_ZWJ),
+        ucd::layer(regional_indicator, GB_REGIONAL_INDICATOR),
+        ucd::layer(hangul_l, GB_L),
+        ucd::layer(hangul_v, GB_V),
+        ucd::layer(hangul_t, GB_T),
+        ucd::layer(extended_pictographic, GB_OTHER | GB_EXT_PICT),
+        ucd::layer(incb_consonant, GB_OTHER | GB_INCB_CONSONANT),
+        ucd::layer(incb_linker, GB_EXTEND | GB_INCB_LINKER),
+        ucd::layer(incb_extend, GB_EXTEND | GB_INCB_EXTEND),
+    },
+    GB_OTHER);
+inline constexpr auto table = ucd::trim<built>();
+
+} // namespace grapheme_detail
+
+inline uint8_t grapheme_prop(char32_t cp) {
+  if (cp >= 0x20 && cp < 0x7F)
+    return GB_OTHER;
+  // Precomposed Hangul syllables alternate LV, LVT x 27.
+  if (cp >= 0xAC00 && cp <= 0xD7A3)
+    return (cp - 0xAC00) % 28 == 0 ? GB_LV : GB_LVT;
+  return grapheme_detail::table[cp];
+}
+
+class GraphemeBreaker {
+public:
+  // Whether a cluster boundary falls before `cp`, which then becomes part
+  // of the state. The first code point after a reset always starts one.
+  bool next(char32_t cp) {
+    // Printable ASCII only joins a Prepend character.
+    if (cp >= 0x20 && cp < 0x7F) {
+      boundary = prev != GB_PREPEND;
+      prev = GB_OTHER;
+      emoji = conjunct = 0;
+      ri_open = false;
+      return boundary;
+    }
+
+    uint8_t props = grapheme_prop(cp);
+    uint8_t gb = props & GB_MASK;
+    bool brk = boundary = breaks(gb, props);
+
+    if (props & GB_EXT_PICT)
+      emoji = 1;
+    else if (emoji == 1 && gb == GB_ZWJ)
+      emoji = 2;
+    else if (!(emoji == 1 && gb == GB_EXTEND))
+      emoji = 0;
+
+    ri_open = gb == GB_REGIONAL_INDICATOR && (brk || !ri_open);
+
+    if (props & GB_INCB_CONSONANT)
+      conjunct = 1;
+    else if (conjunct && (props & GB_INCB_LINKER))
+      conjunct = 2;
+    else if (conjunct && !((props & GB_INCB_EXTEND) || gb == GB_ZWJ))
+      conjunct = 0;
+
+    prev = gb;
+    return brk;
+  }
+
+  // Cells `cp` adds to the text so far: its own width if it starts a
+  // cluster, otherwise none, except that the second half of a flag widens
+  // it to two.
+  size_t advance(char32_t cp) {
+    if (next(cp))
+      return static_cast<size_t>(char_width(cp));
+    return prev == GB_REGIONAL_INDICATOR ? 1 : 0;
+  }
+
+  // Whether the last code point started a cluster.
+  bool at_boundary() const { return boundary; }
+
+  void reset() { *this = GraphemeBreaker{}; }
+
+private:
+  static constexpr uint8_t NONE = 0xFF;
+
+  uint8_t prev = NONE;
+  uint8_t emoji = 0;     // 1: ExtPict Extend*, 2: ... followed by ZWJ
+  uint8_t conjunct = 0;  // 1: Consonant [Extend]*, 2: ... with a Linker
+  bool ri_open = false;  // odd regional indicator waiting for its pair
+  bool boundary = false;
+
+  bool breaks(uint8_t gb, uint8_t props) const {
+    if (prev == NONE)
+      return true;
+    if (prev == GB_CR && gb == GB_LF)
+      return false;                                               // GB3
+    if (prev == GB_CONTROL || prev == GB_CR || prev == GB_LF)
+      return true;                                                // GB4
+    if (gb == GB_CONTROL || gb == GB_CR || gb == GB_LF)
+      return true;                                                // GB5
+    if (prev == GB_L && (gb == GB_L || gb == GB_V || gb == GB_LV || gb == GB_LVT))
+      return false;                                               // GB6
+    if ((prev == GB_LV || prev == GB_V) && (gb == GB_V || gb == GB_T))
+      return false;                                               // GB7
+    if ((prev == GB_LVT || prev == GB_T) && gb == GB_T)
+      return false;                                               // GB8
+    if (gb == GB_EXTEND || gb == GB_ZWJ || gb == GB_SPACING_MARK)
+      return false;                                               // GB9, GB9a
+    if (prev == GB_PREPEND)
+      return false;                                               // GB9b
+    if ((props & GB_INCB_CONSONANT) && conjunct == 2)
+      return false;                                               // GB9c
+    if ((props & GB_EXT_PICT) && emoji == 2)
+      return false;                                               // GB11
+    if (gb == GB_REGIONAL_INDICATOR && ri_open)
+      return false;                                               // GB12, GB13
+    return true;
+  }
+};
+
+// Cells the character at byte `i` of `s` adds after the text `breaker` has
+// seen, advancing `i` past it. A stray continuation byte (a sequence split
+// across chunks) takes none.
+inline size_t next_cell(GraphemeBreaker &breaker, std::string_view s, size_t &i) {
+  unsigned char c = static_cast<unsigned char>(s[i]);
+  if (c < 0x80) {
+    ++i;
+    return breaker.advance(c);
+  }
+  if ((c & 0xC0) == 0x80) {
+    ++i;
+    return 0;
+  }
+  return breaker.advance(get_next_codepoint(s, i));
+}
+
+// Cells taken by the grapheme cluster starting at byte `i` of `s`, advancing
+// `i` past it: the width of its first character, or two for a flag. Marks
+// cut off from their base by a chunk boundary take none.
+inline size_t next_cluster(std::string_view s, size_t &i) {
+  unsigned char c = static_cast<unsigned char>(s[i]);
+  if (c >= 0x20 && c < 0x80 &&
+      (i + 1 == s.size() || static_cast<unsigned char>(s[i + 1]) < 0x80)) {
+    ++i;
+    return 1;
+  }
+
+  GraphemeBreaker breaker;
+  size_t width = next_cell(breaker, s, i);
+  while (i < s.size()) {
+    if ((static_cast<unsigned char>(s[i]) & 0xC0) == 0x80) {
+      ++i;
+      continue;
+    }
+    size_t at = i;
+    size_t w = next_cell(breaker, s, i);
+    if (breaker.at_boundary()) {
+      i = at;
+      break;
+    }
+    width += w;
+  }
+  return width;
+}
+
+inline size_t text_width(std::string_view s) {
+  size_t n = 0;
+  for (size_t i = 0; i < s.size();)
+    n += next_cluster(s, i);
+  return n;
+}
+
+// Cells `text` adds when appended to `before`: characters that join the
+// last cluster of `before` take none (or one, completing a flag).
+inline size_t appended_width(std::string_view before, std::string_view text) {
+  if (before.empty() || text.empty() || static_cast<unsigned char>(text[0]) < 0x80)
+    return text_width(text);
+
+  // Replay enough of `before` to cover its last cluster.
+  constexpr size_t CONTEXT_BYTES = 64;
+  size_t i = before.size() > CONTEXT_BYTES ? before.size() - CONTEXT_BYTES : 0;
+  while (i < before.size() && (static_cast<unsigned char>(before[i]) & 0xC0) == 0x80)
+    ++i;
+  GraphemeBreaker breaker;
+  while (i < before.size())
+    next_cell(breaker, before, i);
+
+  // Once a new cluster starts, the rest no longer depends on `before`.
+  size_t joined = 0;
+  for (i = 0; i < text.size();) {
+    size_t at = i;
+    if ((static_cast<unsigned char>(text[i]) & 0xC0) == 0x80) {
+      ++i;
+      continue;
+    }
+    size_t w = next_cell(breaker, text, i);
+    if (breaker.at_boundary())
+      return joined + text_width(text.substr(at));
+    joined += w;
+  }
+  return joined;
+}
+
+} // namespace utl
+
+#endif // GRAPHEME_H
@@ -4,6 +4,8 @@
 #include "terminal.h"
 #include "terminal_view.h"
 #include <GLFW/glfw3.h>
+#include <future>
+#include <memory>
 
 #ifdef HAVE_WAYLAND
 #include "wayland_text_input.h"
@@ -24,6 +26,8 @@ public:
     void on_key_press(int key, int action, int mods);
     void on_char(unsigned int codepoint);
     void on_resize(int width, int height);
+    void apply_pending_resize();
+    void zoom(int steps);
 
     // Static GLFW callbacks
     static void scroll_callback(GLFWwindow* w, double x, double y);
@@ -37,8 +41,22 @@ private:
 
     Terminal terminal;
     TerminalView view;
+
+    // Fonts are loaded and common glyphs rasterized on another thread
+    // while the window opens. Started once the terminal has forked the
+    // shell, so the child never inherits a process with threads running.
+    std::future<std::unique_ptr<TextRenderer>> renderer_ready;
     std::unique_ptr<TextRenderer> text_renderer;
 
+    // Resizes are applied once the framebuffer size has been stable for
+    // resize_delay seconds; until then the last frame is letterboxed.
+    int    frame_width    = 0;   // size the terminal grid was laid out for
+    int    frame_height   = 0;
+    int    pending_width  = 0;
+    int    pending_height = 0;
+    double resize_at      = -1.0;   // time of the last unapplied resize
+    double resize_delay   = 0.1;
+
 #ifdef HAVE_WAYLAND
     std::unique_ptr<WaylandTextInput> wayland_input;
 #endif
@@ -0,0 +1,122 @@
+#ifndef LAZY_HISTORY_H
+#define LAZY_HISTORY_H
+
+#include "active_line.h"
+#include "grapheme.h"
+#include "line_block.h"
+#include "row_index.h"
+#include "scrollback.h"
+#include "terminal_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+// History kept as the raw bytes the shell printed.
+//
+// Ingestion only copies bytes and records where lines start, so it runs at
+// roughly memcpy speed. Every GROUP_LINES lines a checkpoint stores the SGR
+// attributes in effect; a ParsedLine is only built when someone asks for
+// it, by replaying its group through a private parser into a LineBlock.
+// Replayed groups are kept in a small LRU. The unfinished last line has a
+// parser of its own that is fed new bytes as they arrive.
+//
+// Newlines are only indexed in text appended while the parser is idle,
+// which matches where the parser itself emits NEWLINE actions.
+class LazyHistory {
+public:
+    static constexpr size_t GROUP_LINES = 256;
+    static constexpr size_t MATERIALIZED_CACHE_GROUPS = 4;
+    static constexpr size_t COMPACT_TAIL_BYTES = 4096;
+
+    LazyHistory();
+
+    void set_limits(size_t max_lines, size_t max_bytes);
+
+    // Plain bytes (no escape sequences) printed with attributes `attrs`.
+    // Returns the number of lines finished by this text.
+    size_t append_text(const char* data, size_t len, const TerminalAttributes& attrs);
+
+    // Bytes of an escape sequence; only replayed, never indexed.
+    void append_sequence(const char* data, size_t len);
+
+    // Rewrites the raw bytes of the unfinished last line as the line it
+    // currently shows, followed by `attrs` (the live parser's attributes).
+    // Keeps `\r`-redrawn progress output from growing without bound. Only
+    // call this between escape sequences.
+    void compact_active(const TerminalAttributes& attrs);
+
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Valid until another group is materialized.
+    LineView operator[](size_t i) const;
+
+    // The unfinished last line.
+    const ActiveLine& active() const;
+
+    ScrollbackUsage usage() const { return {count, bytes + row_index.memory()}; }
+
+    // Cell counts are estimated from the raw text: printable code points,
+    // with \r and backspace moving the column. Escape sequences (cursor
+    // moves, erases) are not interpreted.
+    const RowIndex& rows() const { return row_index; }
+
+private:
+    struct Group {
+        uint64_t id = 0;
+        std::string bytes;
+        std::vector<uint32_t> line_starts;
+        TerminalAttributes attrs;   // checkpoint at bytes[0]
+    };
+
+    struct Materialized {
+        uint64_t id;
+        LineBlock lines;
+    };
+
+    std::deque<Group> groups;
+    size_t head = 0;   // evicted lines inside groups.front()
+    size_t count = 0;  // finished lines retained
+    size_t bytes = 0;
+    uint64_t next_group_id = 0;
+
+    size_t line_limit = Scrollback::DEFAULT_MAX_LINES;
+    size_t byte_limit = Scrollback::DEFAULT_MAX_BYTES;
+
+    TerminalAttributes tail_attrs;   // attributes where the last line starts
+    size_t compacted_tail = 0;       // size of the last line after compaction
+
+    RowIndex row_index;
+    size_t tail_col = 0;             // estimated column in the last line
+    size_t tail_cells = 0;           // estimated width of the last line
+    utl::GraphemeBreaker tail_breaker;   // clusters open in the last line
+    std::vector<RowIndex::WideRun> tail_wide;   // its wide clusters, by cell
+
+    mutable TerminalParser replay_parser;
+    mutable std::list<Materialized> materialized;   // most recently used first
+
+    // The unfinished line, kept up to date by parsing only the bytes
+    // appended since the last call to active().
+    mutable TerminalParser active_parser;
+    mutable ActiveLine active_line;
+    mutable uint64_t active_group = UINT64_MAX;   // group the tail was read from
+    mutable size_t active_start = 0;              // where the line starts in it
+    mutable size_t active_fed = 0;                // bytes parsed so far
+
+    void start_group(const TerminalAttributes& attrs);
+    void touch_back();
+    void measure(const char* p, const char* end);
+    void overwrite_wide(size_t w);
+    void evict_front();
+    void enforce_limits();
+    static size_t group_bytes(const Group& group);
+    const LineBlock& materialize(const Group& group) const;
+    void replay(const Group& group, LineBlock& lines) const;
+};
+
+#endif // LAZY_HISTORY_H
@@ -0,0 +1,116 @@
+#ifndef LINE_BLOCK_H
+#define LINE_BLOCK_H
+
+#include "terminal_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class LineBlock;
+
+struct SegmentView {
+    std::string_view content;
+    const TerminalAttributes& attributes;
+};
+
+// Read-only view of one line stored in a LineBlock. Cheap to copy; valid as
+// long as the block it points into.
+class LineView {
+public:
+    class iterator {
+    public:
+        iterator(const LineBlock* block, uint32_t run) : block(block), run(run) {}
+        SegmentView operator*() const;
+        iterator& operator++() { ++run; return *this; }
+        bool operator==(const iterator& other) const { return run == other.run; }
+        bool operator!=(const iterator& other) const { return run != other.run; }
+
+    private:
+        const LineBlock* block;
+        uint32_t run;
+    };
+
+    LineView() = default;
+    LineView(const LineBlock* block, uint32_t line);
+
+    iterator begin() const { return {block, first_run}; }
+    iterator end() const { return {block, last_run}; }
+    // Latest run starting at or before cell `cell`, with the cells before
+    // it in `run_cell`. Only long lines keep run positions; shorter ones
+    // start from the beginning.
+    iterator seek(size_t cell, size_t& run_cell) const;
+    size_t segment_count() const { return last_run - first_run; }
+    bool empty() const { return first_run == last_run; }
+
+    LineType type() const;
+    bool clear_screen() const;
+
+private:
+    const LineBlock* block = nullptr;
+    uint32_t line = 0;
+    uint32_t first_run = 0;
+    uint32_t last_run = 0;
+};
+
+// Columnar storage for a batch of history lines.
+//
+//   text         one UTF-8 arena for every line
+//   run_offset   start of each attribute run inside `text`, plus a sentinel
+//   run_attr     index into `attrs` for each run
+//   line_run     first run of each line, plus a sentinel
+//   line_flags   LineType and clear_screen packed in a byte
+//
+// A line costs 5 bytes plus 8 bytes per attribute run on top of its text,
+// and a scan over history walks a few flat arrays.
+//
+// Lines longer than LONG_LINE_BYTES also keep the cells before each of
+// their runs. Lines come from ActiveLine, whose chunks bound a run to a
+// few KB, so drawing from the middle of a huge line starts that close to
+// the first visible cell. These offsets are not serialized but rebuilt
+// when a block is decoded.
+class LineBlock {
+public:
+    static constexpr size_t LONG_LINE_BYTES = 16384;
+
+    LineBlock();
+
+    void push_back(const ParsedLine& line);
+    void clear();
+
+    size_t size() const { return line_flags.size(); }
+    bool empty() const { return line_flags.empty(); }
+    LineView operator[](size_t i) const;
+
+    size_t memory() const;
+
+    std::string serialize() const;
+    static bool deserialize(const std::string& in, LineBlock& out);
+
+private:
+    friend class LineView;
+
+    std::string text;
+    std::vector<uint32_t> run_offset;
+    std::vector<uint32_t> run_attr;
+    std::vector<uint32_t> line_run;
+    std::vector<uint8_t> line_flags;
+    std::vector<TerminalAttributes> attrs;
+    // Hash of each attribute set to its id, for blocks built with
+    // push_back(); deserialized blocks are never added to.
+    std::unordered_map<uint64_t, uint32_t> attr_ids;
+
+    struct LongLine {
+        uint32_t line;
+        uint32_t first;   // its first entry in run_cells
+    };
+    std::vector<LongLine> long_lines;
+    std::vector<uint32_t> run_cells;
+
+    uint32_t intern(const TerminalAttributes& a);
+    void index_long_line(uint32_t line);
+};
+
+#endif // LINE_BLOCK_H
@@ -0,0 +1,22 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Small LZ4-style block codec used for cold scrollback.
+//
+// The format follows the LZ4 block layout: each sequence is a token byte
+// (literal length in the high nibble, match length - 4 in the low nibble),
+// optional length extension bytes, the literals and a 16-bit little-endian
+// match offset. The final sequence carries literals only.
+namespace lz {
+std::vector<uint8_t> compress(std::string_view input);
+bool decompress(const uint8_t *src, size_t size, std::string &out,
+                size_t raw_size);
+} // namespace lz
+
+#endif // LZ_H
@@ -6,8 +6,9 @@
 
 
 namespace oglutil {
-    void load_glyph_to_texture(FT_GlyphSlot glyph, unsigned int &texture);
-    void render_texture_over_rectangle(unsigned int& texture, unsigned int vbo, float xpos, float ypos, float w, float h);
+    // (u0, v0)-(u1, v1) is the part of the texture to draw, v0 at the top.
+    void render_texture_over_rectangle(unsigned int texture, unsigned int vbo, float xpos, float ypos, float w, float h,
+                                       float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f);
     void draw_rectangle(float x, float y, float scale);
 }
 
@@ -0,0 +1,49 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <array>
+#include <cstdint>
+
+// The terminal's colour table: the 256 xterm colours followed by the
+// default foreground and background.
+//
+// Cells refer to colours by slot, and the text shader looks slots up in a
+// copy of this table kept in a texture, so a program changing colours
+// (OSC 4/10/11) or a theme switch costs one upload of the table instead of
+// any per-cell work.
+class Palette {
+public:
+  static constexpr int COLORS = 256;
+  static constexpr int FOREGROUND = 256;
+  static constexpr int BACKGROUND = 257;
+  static constexpr int SIZE = 258;
+
+  struct Rgb {
+    uint8_t r, g, b;
+  };
+
+  Palette();
+
+  // The colour a slot starts with: the 16 ANSI colours, the 6x6x6 cube,
+  // the grey ramp, white on black.
+  static Rgb default_color(int slot);
+
+  const Rgb &operator[](int slot) const { return colors[slot]; }
+  void set(int slot, Rgb rgb);
+  void reset(int slot);
+
+  // SIZE packed RGB triples.
+  const uint8_t *data() const { return &colors[0].r; }
+
+  // Changes whenever a colour does, for noticing that the GPU copy is
+  // stale.
+  uint64_t version() const { return changes; }
+
+private:
+  std::array<Rgb, SIZE> colors;
+  uint64_t changes = 1;
+};
+
+static_assert(sizeof(Palette::Rgb) == 3, "Palette::data() packs RGB triples");
+
+#endif // PALETTE_H
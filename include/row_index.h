@@ -0,0 +1,147 @@
+#ifndef ROW_INDEX_H
+#define ROW_INDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "grapheme.h"
+
+// Visual-row index over history lines.
+//
+// Each line records how many cells it occupies and where its double-width
+// clusters sit. At a given width it wraps the way the renderer lays it
+// out: narrow cells fill a row to the last column, a double-width cluster
+// that would straddle it moves to the next row. Lines without wide
+// clusters take max(1, ceil(cells / cols)) rows. A Fenwick tree over the
+// row counts answers "which line holds visual row R" and "how many rows come
+// before line N" in O(log n). The tree is built for one width at a time and
+// rebuilt lazily (O(n)) when the width changes; appends and evictions
+// update it in O(log n).
+//
+// Evicted lines keep a zero-row slot at the front until more than half of
+// the slots are dead, then the storage is compacted.
+//
+// For large histories the rebuild after a width change runs on a worker
+// thread over a snapshot of the cell counts; lines appended or evicted in
+// the meantime are replayed onto the finished tree. Until then ready()
+// reports false and callers position by the lines around the viewport.
+class RowIndex {
+public:
+    static constexpr size_t BACKGROUND_MIN_LINES = 65536;
+
+    // `count` double-width clusters back to back from cell `cell`.
+    struct WideRun {
+        uint32_t cell;
+        uint32_t count;
+    };
+
+    // Measures a line for push_back, a piece of text at a time.
+    class LineCells {
+    public:
+        void add(std::string_view text);
+        size_t cells() const { return total; }
+        const std::vector<WideRun>& wide() const { return runs; }
+
+    private:
+        utl::GraphemeBreaker breaker;
+        size_t total = 0;
+        std::vector<WideRun> runs;
+    };
+
+    RowIndex() = default;
+    RowIndex(const RowIndex&) = delete;
+    RowIndex& operator=(const RowIndex&) = delete;
+
+    // `wide` is sorted by cell and lies within the line.
+    void push_back(size_t cells, std::span<const WideRun> wide = {});
+    void push_back(const LineCells& line) { push_back(line.cells(), line.wide()); }
+    void pop_front();
+    void clear();
+
+    size_t size() const { return slots.cells.size() - first; }
+    bool empty() const { return size() == 0; }
+    size_t cells_at(size_t line) const { return slots.cells[first + line]; }
+
+    // Rows line `line` wraps to at `cols`, and the cell row `row` of it
+    // starts at (the line's cell count past its last row). O(1) for lines
+    // without wide clusters, otherwise linear in their runs.
+    size_t rows_at(size_t line, size_t cols) const {
+        return slots.rows(first + line, std::max<size_t>(cols, 1));
+    }
+    size_t row_start(size_t line, size_t cols, size_t row) const;
+
+    // Bytes held for the live lines, tree included. Dead front slots are
+    // left out: compaction keeps them to at most as many again.
+    size_t memory() const;
+
+    // Whether queries at `cols` can be answered without a full rebuild.
+    // Starts a background rebuild if needed; at most one runs at a time.
+    // The queries below always work, rebuilding synchronously if they have
+    // to.
+    bool ready(size_t cols) const;
+
+    size_t total(size_t cols) const;
+    size_t rows_before(size_t cols, size_t line) const;
+
+    // Line holding visual row `row` and the row's offset inside that line.
+    // Rows past the end map to (size(), 0).
+    std::pair<size_t, size_t> locate(size_t cols, size_t row) const;
+
+    // Rows a line of `cells` cells wraps to, given where its wide clusters
+    // sit; row `row` starts at `*start` if it exists.
+    static size_t layout(size_t cells, std::span<const WideRun> wide, size_t cols,
+                         size_t row = SIZE_MAX, size_t* start = nullptr);
+    static size_t rows_for(size_t cells, size_t cols) {
+        return cells == 0 ? 1 : (cells + cols - 1) / cols;
+    }
+
+private:
+    // Per-slot storage, copied whole for background rebuilds. Lines with
+    // wide clusters are listed by slot, their runs pooled.
+    struct Slots {
+        struct Wide {
+            size_t slot;
+            uint32_t begin;   // first run in `runs`
+        };
+
+        std::vector<uint32_t> cells;   // per line, including dead front slots
+        std::vector<Wide> wide_lines;
+        std::vector<WideRun> runs;
+
+        std::span<const WideRun> wide(size_t slot) const;
+        size_t rows(size_t slot, size_t cols) const;
+        void drop_front(size_t n);
+    };
+
+    struct Job {
+        size_t cols = 0;
+        uint64_t generation = 0;
+        size_t first = 0;   // snapshot of the slots the tree was built over
+        size_t size = 0;
+        std::vector<uint64_t> tree;
+        std::atomic<bool> done{false};
+    };
+
+    Slots slots;
+    size_t first = 0;              // first live slot
+    uint64_t generation = 0;       // bumped when slots are renumbered
+
+    mutable std::vector<uint64_t> tree;   // 1-based Fenwick tree
+    mutable size_t tree_cols = 0;         // 0: not built
+    mutable std::shared_ptr<Job> job;
+
+    void build(size_t cols) const;
+    void adopt(Job& done) const;
+    void append_node() const;
+    uint64_t prefix(size_t n) const;
+    static std::vector<uint64_t> make_tree(const Slots& slots, size_t first,
+                                           size_t cols);
+};
+
+#endif // ROW_INDEX_H
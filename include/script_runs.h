@@ -0,0 +1,106 @@
+#ifndef SCRIPT_RUNS_H
+#define SCRIPT_RUNS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Script itemization for rendering.
+//
+// Text is split into runs of one Unicode script (UAX #24 Script property,
+// from coarse compile-time ranges). Common characters (spaces,
+// punctuation, digits) and Inherited ones (combining marks, ZWJ/ZWNJ,
+// variation selectors) take the script of the run they fall in; leading
+// ones take the first real script after them. Runs are byte spans over the
+// source text, so itemizing allocates nothing per run.
+
+namespace utl {
+
+enum class Script : uint8_t {
+  Common,
+  Inherited,
+  Latin,
+  Greek,
+  Cyrillic,
+  Armenian,
+  Hebrew,
+  Arabic,
+  Syriac,
+  Thaana,
+  Nko,
+  Devanagari,
+  Bengali,
+  Gurmukhi,
+  Gujarati,
+  Oriya,
+  Tamil,
+  Telugu,
+  Kannada,
+  Malayalam,
+  Sinhala,
+  Thai,
+  Lao,
+  Tibetan,
+  Myanmar,
+  Georgian,
+  Hangul,
+  Ethiopic,
+  Khmer,
+  Mongolian,
+  Hiragana,
+  Katakana,
+  Han,
+};
+
+struct ScriptRun {
+  uint32_t begin;   // byte offsets into the itemized text
+  uint32_t end;
+  Script script;
+};
+
+Script script_of(char32_t cp);
+
+// ISO 15924 code ("Deva", "Arab", ...); "Zyyy" for Common, "Zinh" for
+// Inherited.
+const char *script_tag(Script script);
+
+// Whether runs of `script` have to be shaped as a whole (reordering,
+// conjuncts, cursive joining) rather than drawn cluster by cluster.
+bool needs_shaping(Script script);
+
+void itemize(std::string_view text, std::vector<ScriptRun> &runs);
+
+// Runs of recently drawn text, keyed by content. The renderer asks for the
+// same lines every frame; a line that has not changed is found by hash
+// instead of being decoded again. Pure ASCII text needs no table lookups
+// and is not cached. Entries not asked for during the last few frames are
+// dropped by next_frame().
+class ScriptRunCache {
+public:
+  const std::vector<ScriptRun> &runs(std::string_view text);
+  void next_frame();
+  void clear() { entries.clear(); }
+
+private:
+  static constexpr uint32_t KEEP_FRAMES = 8;
+
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+  struct Entry {
+    std::vector<ScriptRun> runs;
+    uint32_t used = 0;   // frame of the last lookup
+  };
+
+  std::unordered_map<std::string, Entry, Hash, std::equal_to<>> entries;
+  std::vector<ScriptRun> ascii;
+  uint32_t frame = 0;
+};
+
+} // namespace utl
+
+#endif // SCRIPT_RUNS_H
@@ -0,0 +1,119 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include "line_block.h"
+#include "row_index.h"
+#include "scrollback_file.h"
+#include "terminal_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+struct ScrollbackUsage {
+    size_t lines = 0;
+    size_t bytes = 0;
+    size_t cold_blocks = 0;
+    size_t disk_bytes = 0;
+};
+
+// History store for finished lines in the main screen.
+//
+// Lines live in fixed-size LineBlocks kept in a deque, which acts as a ring:
+// new lines go to the back block, the oldest line is dropped from the front
+// block and an emptied front block is popped, so eviction is O(1). Memory
+// of evicted lines is returned a whole block at a time.
+// A limit of 0 means "unlimited".
+//
+// Once a full block is more than `cold_after` blocks away from the newest
+// one it is sealed: its LineBlock is serialized and compressed with the
+// in-tree LZ codec. Cold blocks are decoded on access into a small LRU.
+//
+// With disk backing enabled, sealed blocks are appended to a per-session
+// ScrollbackFile instead of staying in RAM; each block only remembers its
+// file offset, so reaching line N is still one block lookup. The byte limit
+// then only counts resident memory: block stubs and the row index, which
+// grow with the line count even when the text is on disk.
+class Scrollback {
+public:
+    static constexpr size_t BLOCK_LINES = 256;
+    static constexpr size_t DEFAULT_MAX_LINES = 100000;
+    static constexpr size_t DEFAULT_MAX_BYTES = 64u << 20;
+    static constexpr size_t DEFAULT_COLD_AFTER = 4;
+    static constexpr size_t DECODED_CACHE_BLOCKS = 4;
+
+    explicit Scrollback(size_t max_lines = DEFAULT_MAX_LINES,
+                        size_t max_bytes = DEFAULT_MAX_BYTES);
+
+    void set_limits(size_t max_lines, size_t max_bytes);
+    size_t max_lines() const { return line_limit; }
+    size_t max_bytes() const { return byte_limit; }
+
+    // Number of newest blocks kept uncompressed; 0 disables compression.
+    void set_cold_after(size_t blocks);
+
+    // Moves sealed blocks to a file under `dir` ($XDG_RUNTIME_DIR or /tmp
+    // when empty). The file is removed on exit unless `keep` is set.
+    bool enable_disk_backing(const std::string& dir = "", bool keep = false);
+    bool disk_backed() const { return file.is_open(); }
+
+    void push_back(const ParsedLine& line);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // The view stays valid until lines from another cold block are
+    // requested (it may point into the decoded-block cache).
+    LineView operator[](size_t i) const;
+
+    ScrollbackUsage usage() const;
+
+    // Wrapped rows per line, for visual-row positioning.
+    const RowIndex& rows() const { return row_index; }
+
+private:
+    struct Block {
+        uint64_t id = 0;
+        LineBlock lines;                 // hot blocks only
+        std::vector<uint8_t> packed;     // cold blocks kept in RAM
+        uint64_t file_offset = 0;        // cold blocks spilled to disk
+        size_t packed_size = 0;
+        size_t raw_size = 0;
+        size_t bytes = 0;
+        bool cold = false;
+        bool spilled = false;
+    };
+
+    struct Decoded {
+        uint64_t id;
+        LineBlock lines;
+    };
+
+    std::deque<Block> blocks;
+    size_t head = 0;   // first live line inside blocks.front()
+    size_t count = 0;
+    size_t bytes = 0;
+    uint64_t next_block_id = 0;
+
+    size_t line_limit;
+    size_t byte_limit;
+    size_t cold_after = DEFAULT_COLD_AFTER;
+
+    RowIndex row_index;
+
+    mutable std::list<Decoded> decoded;   // most recently used first
+    mutable ScrollbackFile file;
+
+    size_t resident() const { return bytes + row_index.memory(); }
+    void evict_front();
+    void enforce_limits();
+    void seal_cold_blocks();
+    void seal(Block& block);
+    void spill(Block& block);
+    const LineBlock& decode(const Block& block) const;
+};
+
+#endif // SCROLLBACK_H
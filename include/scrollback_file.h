@@ -0,0 +1,53 @@
+#ifndef SCROLLBACK_FILE_H
+#define SCROLLBACK_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Append-only per-session file holding sealed scrollback blocks.
+//
+// Blocks are written with pwrite() and read back through a read-only
+// mmap() of the file that is grown on demand, so history pages are backed
+// by the page cache instead of the heap. Unless `keep` is requested the
+// file is unlinked right after creation: it disappears on exit (or crash)
+// while the open descriptor keeps it usable.
+class ScrollbackFile {
+public:
+    ScrollbackFile() = default;
+    ~ScrollbackFile();
+
+    ScrollbackFile(const ScrollbackFile&) = delete;
+    ScrollbackFile& operator=(const ScrollbackFile&) = delete;
+
+    bool open(const std::string& dir, bool keep);
+    void close();
+    bool is_open() const { return fd >= 0; }
+    const std::string& file_path() const { return path; }
+
+    // Returns the offset the data was written at, or UINT64_MAX on failure.
+    uint64_t append(const uint8_t* data, size_t size);
+
+    // Pointer to `size` bytes at `offset`, valid until the next data().
+    const uint8_t* data(uint64_t offset, size_t size);
+
+    // Releases the disk space of a block that was evicted.
+    void discard(uint64_t offset, size_t size);
+
+    // Drops every block, e.g. when the screen is cleared.
+    void reset();
+
+    uint64_t size() const { return file_size; }
+
+private:
+    int fd = -1;
+    std::string path;
+    uint64_t file_size = 0;
+
+    uint8_t* map = nullptr;
+    size_t map_size = 0;
+
+    bool ensure_mapped(uint64_t end);
+};
+
+#endif // SCROLLBACK_FILE_H
@@ -3,11 +3,17 @@
 
 #include <string>
 
+// A GL program built from vertex and fragment shader source.
+//
+// The linked program is saved under the cache directory, keyed by the
+// sources and the driver's vendor, renderer and version strings, and
+// loaded from there on later runs instead of being compiled. A binary the
+// driver rejects is compiled from source again and replaced.
 class Shader {
 public:
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    Shader(const char* vertexCode, const char* fragmentCode);
     void use();
     void set_bool(const std::string &name, bool value) const;
     void set_int(const std::string &name, int value) const;
@@ -16,6 +22,9 @@ public:
     void set_mat4(const std::string &name, const float* value) const;
 
 private:
+    std::string binary_path(const char* vertexCode, const char* fragmentCode) const;
+    bool load_binary(const std::string& path);
+    void save_binary(const std::string& path) const;
     void check_compile_errors(unsigned int shader, std::string type);
 };
 
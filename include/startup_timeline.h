@@ -0,0 +1,63 @@
+#ifndef STARTUP_TIMELINE_H
+#define STARTUP_TIMELINE_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// When each part of startup ran, from any thread, measured from process
+// start. Phases that overlap (fonts loading while the window opens) show
+// up as overlapping spans, so the report shows what the first prompt
+// actually waited for.
+class StartupTimeline {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Records a span from construction to destruction.
+  class Phase {
+  public:
+    Phase(StartupTimeline &timeline, std::string name)
+        : timeline(timeline), name(std::move(name)), begin(Clock::now()) {}
+    ~Phase() { timeline.add(std::move(name), begin, Clock::now()); }
+    Phase(const Phase &) = delete;
+    Phase &operator=(const Phase &) = delete;
+
+  private:
+    StartupTimeline &timeline;
+    std::string name;
+    Clock::time_point begin;
+  };
+
+  static StartupTimeline &get();
+
+  // Off by default; nothing is recorded or printed until turned on.
+  void set_enabled(bool on) {
+    std::lock_guard lock(mutex);
+    enabled = on;
+  }
+
+  Phase phase(std::string name) { return Phase(*this, std::move(name)); }
+  // A moment rather than a span.
+  void mark(std::string name);
+  void add(std::string name, Clock::time_point begin, Clock::time_point end);
+
+  // Prints every entry in order of start, once.
+  void report();
+
+private:
+  struct Entry {
+    std::string name;
+    Clock::time_point begin, end;
+    size_t thread;   // numbered in order of first entry
+  };
+
+  std::mutex mutex;
+  std::vector<Entry> entries;
+  std::vector<std::thread::id> threads;
+  bool enabled = false;
+  bool reported = false;
+};
+
+#endif // STARTUP_TIMELINE_H
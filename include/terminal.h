@@ -1,8 +1,15 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include "active_line.h"
+#include "grapheme.h"
+#include "lazy_history.h"
+#include "palette.h"
+#include "scrollback.h"
 #include "terminal_parser.h"
 #include "tty.h"
+#include "utf8_decoder.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -20,6 +27,16 @@ public:
     void scroll_page_up();
     void scroll_page_down();
     void scroll_to_bottom();
+    void set_scrollback_limits(size_t max_lines, size_t max_bytes);
+    ScrollbackUsage scrollback_usage() const {
+        return lazy_history_mode ? lazy_history.usage() : parsed_buffer.usage();
+    }
+    bool enable_disk_scrollback(bool keep_file = false);
+
+    // Keep main-screen output as raw bytes and only build lines on demand.
+    // Switching modes starts with an empty history.
+    void set_lazy_history(bool enable);
+    bool lazy_history_enabled() const { return lazy_history_mode; }
 
     // Input
     void send_input(const std::string& input);
@@ -36,8 +53,17 @@ public:
 
     // Exposed for renderer
     const std::vector<std::vector<Cell>>& screen() const { return screen_buffer; }
-    const std::vector<ParsedLine>& history() const { return parsed_buffer; }
+    const Scrollback& history() const { return parsed_buffer; }
+    size_t history_size() const;
+    LineView history_line(size_t i) const;
+    const RowIndex& history_rows() const;
+    const ActiveLine& current_line() const;
     int scroll_offset_value() const { return scroll_offset; }
+    // History-mode rows on screen (the grid less the bottom margin row) and
+    // how far they can scroll back, in wrapped visual rows. The view draws
+    // with these so scrolling and drawing agree.
+    int visible_rows() const { return std::max(screen_rows - 1, 1); }
+    int max_scroll_offset() const;
     int rows() const { return screen_rows; }
     int cols() const { return screen_cols; }
 
@@ -55,6 +81,7 @@ public:
     bool wrap_next = false;
 
     std::vector<std::vector<Cell>> screen_buffer;
+    std::vector<uint8_t> screen_wrapped;   // per row: continued by auto-wrap
     int screen_cursor_row = 0;
     int screen_cursor_col = 0;
     int screen_rows = 24;
@@ -63,12 +90,17 @@ public:
     int scroll_region_top = 0;
     int scroll_region_bottom = -1;
 
-    std::string pending_utf8;
+    utl::Utf8Decoder utf8;           // carries sequences split across reads
+    utl::GraphemeBreaker grapheme;   // cluster open at the cursor
+
+    Scrollback parsed_buffer;
+    ActiveLine active_line;
 
-    std::vector<ParsedLine> parsed_buffer;
-    ParsedLine active_line;
+    bool lazy_history_mode = false;
+    LazyHistory lazy_history;
 
     TerminalParser parser;
+    Palette palette;   // as changed by OSC 4/10/11
 
     std::string preedit_text;
     int preedit_cursor = 0;
@@ -81,18 +113,20 @@ public:
 private:
     // High-level processing
     void process_actions(const std::vector<TerminalAction>& actions);
+    void process_palette(const TerminalAction& a);
     void process_screen_mode(const TerminalAction& a);
     void process_history_mode(const TerminalAction& a);
+    void ingest_lazy(const std::string& bytes);
 
-    // UTF‑8 / combining
-    bool decode_next_utf8(std::string& pending, std::string& out_char);
-    uint32_t decode_codepoint(const std::string& utf8) const;
-    bool is_combining(uint32_t cp) const;
-    void apply_combining(const std::string& mark);
+    // Grapheme clusters
+    void apply_combining(std::string_view mark, const TerminalAttributes& attr, int width);
 
     // Screen operations
     void handle_print_text(const std::string& text, const TerminalAttributes& attr);
-    void write_char(const std::string& utf8, const TerminalAttributes& attr);
+    void print_char(char32_t cp, std::string_view utf8, const TerminalAttributes& attr);
+    void write_char(std::string_view utf8, const TerminalAttributes& attr, int width = 1);
+    void split_wide(int row, int col);
+    void advance_cursor(int width);
     void newline();
     void carriage_return();
     void backspace();
@@ -106,11 +140,10 @@ private:
     void erase_chars(int count, const TerminalAttributes& attr);
     void perform_scroll_up();
     void perform_scroll_down();
+    void reflow_screen(int rows, int cols);
 
     // History mode
-    void append_history_text(const std::string& text, const TerminalAttributes& attr);
     void finalize_history_line();
-    void backspace_history();
 };
 
 #endif // TERMINAL_H
@@ -4,6 +4,7 @@
 #include <map>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class ActionType {
@@ -36,7 +37,13 @@ enum class ActionType {
   SCROLL_TEXT_UP,
   SCROLL_TEXT_DOWN,
   SET_APPLICATION_CURSOR_KEYS,
-  NEXT_LINE
+  NEXT_LINE,
+  // OSC 4/10/11: `row` is the Palette slot; `attributes.foreground` holds
+  // the RGB colour, or `flag` asks for the current one to be reported,
+  // the reply ending with `text` (BEL or ST, as the query did).
+  SET_PALETTE_COLOR,
+  // OSC 104/110/111: `row` is the Palette slot, -1 for all 256 colours.
+  RESET_PALETTE_COLOR
 };
 
 enum class AnsiColor {
@@ -139,6 +146,19 @@ public:
   TerminalParser();
   std::vector<TerminalAction> parse_input(const std::string &input);
 
+  // Feeds bytes until the parser is back in its normal state (i.e. one
+  // complete escape sequence) and returns how many bytes were consumed.
+  size_t parse_sequence(const char *data, size_t len,
+                        std::vector<TerminalAction> &actions);
+
+  bool idle() const { return state == State::NORMAL; }
+  const TerminalAttributes &attributes() const { return current_attributes; }
+  void reset(const TerminalAttributes &attrs);
+
+  // SGR sequence that, applied from any state, leaves exactly `attrs` in
+  // effect (including colour fields the current type does not use).
+  static std::string encode_attributes(const TerminalAttributes &attrs);
+
   // Deprecated, kept for compatibility during refactor
   std::vector<ParsedLine> parse_output(const std::string &output);
 
@@ -156,6 +176,7 @@ private:
   std::string escape_buf;
   std::vector<int> csi_args;
   std::string str_buf;
+  char str_kind = 0;   // character after ESC that opened the string
   char csi_mode = 0;
   bool csi_priv = false;
 
@@ -174,7 +195,10 @@ private:
   void handle_escape(char c, std::vector<TerminalAction> &actions);
   void handle_csi(char c, std::vector<TerminalAction> &actions);
   void parse_csi_params();
-  void handle_str(char c);
+  void handle_str(char c, std::vector<TerminalAction> &actions);
+  void handle_osc(std::string_view body, std::string_view terminator,
+                  std::vector<TerminalAction> &actions);
+  static bool parse_color_spec(std::string_view spec, TerminalColor &color);
 
   // Action helpers
   void update_attributes(const std::vector<int> &params);
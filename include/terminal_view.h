@@ -16,6 +16,9 @@ public:
   void set_window_size(float width, float height);
   void render();
   void update_cursor_blink();
+  // Grows (+) or shrinks (-) the font by `steps`; 0 restores the default.
+  // The grid keeps its size until the next set_window_size().
+  void zoom(int steps);
 
   float get_line_height() const { return LINE_HEIGHT; }
   float get_cell_width()  const { return CELL_WIDTH; }
@@ -32,11 +35,24 @@ private:
 
   float LINE_HEIGHT = 50.0f;
   float CELL_WIDTH  = 15.0f;
+  float BASELINE    = 12.0f;   // above the bottom of a line
+
+  uint64_t palette_version = 0;   // of the palette last uploaded
 
   Coord  cursor_pos;
+  bool   cursor_in_view   = true;   // false while scrolled away from it
   bool   cursor_visible   = true;
   double last_cursor_time = 0.0;
 
+  // Script runs of the text drawn in the last few frames.
+  utl::ScriptRunCache script_runs;
+
+  // History line at the top of the last frame, used to hold the view in
+  // place while the row index is rebuilt for a new width.
+  size_t top_line      = 0;
+  int    anchor_offset = 0;
+  bool   anchored      = false;
+
   // Helpers
   void update_dimensions();
 
@@ -46,11 +62,15 @@ private:
   void draw_cell(float x, float y, const Cell& cell);
 
   void render_line(const ParsedLine &line, float &y_pos);
+  void render_line(const LineView &line, float &y_pos, size_t from_cell = 0);
+  void render_segment(std::string_view content, const TerminalAttributes &attrs,
+                      float &x, float &y_pos);
   void render_cursor(float x, float y);
   void render_preedit(float x, float y);
 
-  void get_color(const TerminalColor &color, float *out_color, bool is_bg = false);
-  void get_color_for_attributes(const TerminalAttributes &attrs, float *color);
+  // Palette slot (or RGB) the shader draws a colour with.
+  static ShaderColor color_of(const TerminalColor &color, bool is_bg = false);
+  static ShaderColor foreground_of(const TerminalAttributes &attrs);
 };
 
 
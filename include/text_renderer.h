@@ -3,11 +3,18 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include "font_fallback.h"
+#include "font_file.h"
+#include "glyph_atlas.h"
+#include "glyph_rasterizer.h"
+#include "script_runs.h"
 #include "shader.h"
-#include <hb-ft.h>
+#include <hb-ot.h>
 #include <hb.h>
-#include <map>
+#include <future>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct Coord {
@@ -15,16 +22,6 @@ struct Coord {
   float y;
 };
 
-// Structure to hold character information
-struct Character {
-  unsigned int texture_id; // ID handle of the glyph texture
-  int width;               // Width of the glyph
-  int height;              // Height of the glyph
-  int bearing_x;           // Horizontal offset from baseline to leftmost
-  int bearing_y;           // Vertical offset from baseline to topmost
-  unsigned int advance;    // Horizontal offset to advance to next glyph
-};
-
 // Structure to hold shaped glyph information
 struct ShapedGlyph {
   unsigned int glyph_id; // HarfBuzz glyph ID
@@ -32,54 +29,128 @@ struct ShapedGlyph {
   float y_offset;        // Y offset from base position
   float x_advance;       // X advance for next glyph
   float y_advance;       // Y advance for next glyph
-  Character *character;  // Pointer to character data
   int font_index;        // Index of the font used for this glyph
 };
 
+// A colour for the text shader: a slot of the palette set with
+// set_palette(), looked up on the GPU, or literal RGB when `slot` is -1.
+struct ShaderColor {
+  int slot = -1;
+  float r = 1.0f, g = 1.0f, b = 1.0f;
+
+  static ShaderColor palette(int slot) { return {slot}; }
+  static ShaderColor rgb(float r, float g, float b) { return {-1, r, g, b}; }
+};
+
 std::string show_char(Character);
 
 class TextRenderer {
 public:
-  TextRenderer();
+  // `fonts` is the main font followed by its fallbacks; only the main font
+  // is opened here. With `sdf` glyphs are kept as distance fields, which
+  // stay sharp at any `scale` passed to render_text_harfbuzz.
+  //
+  // Construction makes no GL calls, so it can run on another thread while
+  // the window is created; init_gl() must then be called on the GL thread
+  // before anything is drawn, and the renderer used only there.
+  explicit TextRenderer(std::vector<std::string> fonts, bool sdf = false);
   ~TextRenderer();
-  void load_font(const char *font_path, unsigned int font_index);
-  Coord render_text_harfbuzz(const std::string &text, Coord cur_pos,
-                             float scale, const float *color, int window_width,
-                             int window_height);
-  float measure_text_width(const std::string &text, float scale);
+  // Builds the shader program, vertex buffers and white texture.
+  void init_gl();
+  // Replaces the colour table ShaderColor slots refer to with `count`
+  // packed RGB triples.
+  void set_palette(const uint8_t *rgb, int count);
+  FT_Face load_font(const char *font_path, unsigned int font_index,
+                    long face_index = 0);
+  // Turns fontconfig lookups for characters no listed font has on or off.
+  void set_font_discovery(bool on) { fallback.set_discovery(on); }
+  // Texture memory the glyph atlas may use.
+  void set_glyph_budget(size_t bytes);
+  // Font size in pixels. Shaping and metrics follow at once; until the
+  // glyphs are rendered at the new size on the workers, the old ones are
+  // drawn scaled. Distance-field glyphs are only ever scaled.
+  void set_pixel_size(unsigned int size);
+  unsigned int get_pixel_size() const { return pixel_size; }
+  static constexpr unsigned int DEFAULT_PIXEL_SIZE = 38;
+  static constexpr unsigned int MIN_PIXEL_SIZE = 8;
+  static constexpr unsigned int MAX_PIXEL_SIZE = 160;
+  // Call once per frame, before drawing: takes in the glyphs rasterized
+  // since the last frame.
+  void next_frame();
+  // Queues printable ASCII, box drawing and the space-separated
+  // `devanagari` clusters for the rasterizer workers. The next frame waits
+  // for all of them and uploads them in one batch.
+  void prewarm(std::string_view devanagari);
+  // Default clusters for prewarm(): vowels, digits, every consonant bare
+  // and with each dependent vowel sign, and frequent conjuncts.
+  static std::string common_devanagari();
+  const GlyphAtlas::Stats &glyph_stats() const { return atlas->stats(); }
+  // `script` is the run's script from utl::itemize; Common lets HarfBuzz
+  // guess.
+  Coord render_text_harfbuzz(std::string_view text, Coord cur_pos,
+                             float scale, const ShaderColor &color,
+                             int window_width, int window_height,
+                             utl::Script script = utl::Script::Common);
+  float measure_text_width(std::string_view text, float scale,
+                           utl::Script script = utl::Script::Common);
   float get_char_width();
   float get_line_height();
+  // Height of the baseline above the bottom of a line.
+  float get_baseline();
   void draw_solid_rectangle(float x, float y, float w, float h,
-                            const float *color, int window_width,
+                            const ShaderColor &color, int window_width,
                             int window_height);
 
 private:
-  unsigned int white_texture;
-  std::map<char, Character> characters;
-  std::map<unsigned int, Character>
-      glyphs; // Map HarfBuzz glyph IDs to characters
-  std::vector<std::map<unsigned int, Character>>
-      font_glyphs; // Glyphs per font using glyph_id as key
-  unsigned int vao, vbo;
-  Shader *shader;
+  unsigned int white_texture = 0;
+  unsigned int palette_texture = 0;   // one row of RGB texels, by slot
+  int palette_size = 0;
+  unsigned int pixel_size = DEFAULT_PIXEL_SIZE;   // shaping and metrics
+  unsigned int atlas_size = DEFAULT_PIXEL_SIZE;   // glyphs in `atlas`
+  size_t glyph_budget = GlyphAtlas::DEFAULT_BUDGET;
+  bool sdf;
+  std::unique_ptr<GlyphAtlas> atlas;
+  std::unique_ptr<GlyphRasterizer> rasterizer;
+  std::vector<GlyphBitmap> rasterized;
+  // Atlas being filled for a new size, swapped in once complete.
+  std::unique_ptr<GlyphAtlas> next_atlas;
+  std::unique_ptr<GlyphRasterizer> next_rasterizer;
+  // Replaced rasterizers, joining their workers and saving their disk
+  // caches on another thread so a zoom never waits for them.
+  std::vector<std::future<void>> retiring;
+  bool prewarming = false;
+  unsigned int vao = 0, vbo = 0;
+  Shader *shader = nullptr;
+  // By chain index. Faces come from the shared library and the fonts'
+  // mappings; HarfBuzz reads the same mappings with its own OpenType code.
   std::vector<FT_Face> ft_faces;
   std::vector<hb_font_t *> hb_fonts;
+  struct FontSource {
+    std::shared_ptr<const FontFile> file;
+    long face_index = 0;
+  };
+  std::vector<FontSource> font_sources;   // for new rasterizers
   hb_buffer_t *hb_buffer;
+  FontFallback fallback;
+
+  // Clusters of a run grouped by the font that draws them: byte range in
+  // the run and chain index.
+  struct FontSpan {
+    size_t begin, end;
+    size_t font_index;
+  };
+  std::vector<FontSpan> font_spans;
 
   void setup_buffers();
-  void set_hb_buffer_properties(hb_buffer_t *buf, const std::string &text);
-  std::vector<ShapedGlyph> get_shaped_glyphs_from_buffer(hb_buffer_t *buf,
-                                                         int font_index);
-  bool try_shape_with_font(hb_buffer_t *buf, hb_font_t *font,
-                           const std::string &text);
-  std::vector<ShapedGlyph> shape_text(const std::string &text);
-  void load_glyph(unsigned int glyph_id, unsigned int font_index);
-  unsigned int get_glyph_id_for_char(char c, unsigned int font_index);
-  const char *main_font;
-  const char *fallback_font;
-  static uint32_t next_code_point(const std::string &s, size_t &i);
-  static bool is_devanagari(uint32_t cp);
-  std::vector<std::string> split_by_devanagari(const std::string &input);
+  void set_color(const ShaderColor &color);
+  void set_hb_scale(hb_font_t *font);
+  void retire(std::unique_ptr<GlyphRasterizer> old);
+  void set_hb_buffer_properties(hb_buffer_t *buf, utl::Script script);
+  void append_shaped_glyphs(hb_buffer_t *buf, size_t font_index,
+                            std::vector<ShapedGlyph> &out);
+  void split_by_font(std::string_view text);
+  std::vector<ShapedGlyph> shape_text(std::string_view text, utl::Script script);
+  const Character *glyph(unsigned int glyph_id, unsigned int font_index);
 };
 
 #endif // TEXT_RENDERER_H
@@ -0,0 +1,161 @@
+#ifndef UNICODE_TABLE_H
+#define UNICODE_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time two-level lookup tables for Unicode properties.
+//
+// A property is described as layers of sorted code point ranges, each
+// painting one byte value over the ranges before it. build() folds them
+// into 256-entry blocks, keeping only the distinct ones: the high bits of
+// a code point pick a block, the low bits index into it, so a lookup is
+// two array loads.
+//
+// Blocks no layer touches, and blocks one range covers entirely, are
+// classified without painting; that keeps the constexpr evaluation well
+// inside the compiler's operation limits.
+
+namespace utl::ucd {
+
+struct Range {
+  char32_t first;
+  char32_t last;
+};
+
+struct Layer {
+  const Range *ranges;
+  size_t count;
+  uint8_t value;
+};
+
+template <size_t N> constexpr Layer layer(const Range (&ranges)[N], uint8_t value) {
+  return {ranges, N, value};
+}
+
+template <size_t N> constexpr bool sorted(const Range (&ranges)[N]) {
+  for (size_t i = 0; i < N; ++i) {
+    if (ranges[i].first > ranges[i].last)
+      return false;
+    if (i > 0 && ranges[i - 1].last >= ranges[i].first)
+      return false;
+  }
+  return true;
+}
+
+inline constexpr size_t BLOCK_BITS = 8;
+inline constexpr size_t BLOCK_SIZE = size_t{1} << BLOCK_BITS;
+inline constexpr size_t BLOCKS = 0x110000 >> BLOCK_BITS;
+inline constexpr size_t MAX_BLOCKS = 256; // first level stores bytes
+
+using Block = std::array<uint8_t, BLOCK_SIZE>;
+
+// Index of the first range in `l` ending at or after `cp`.
+constexpr size_t lower_bound(const Layer &l, char32_t cp) {
+  size_t lo = 0, hi = l.count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (l.ranges[mid].last < cp)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+struct Builder {
+  std::array<uint8_t, BLOCKS> stage1{};
+  std::array<Block, MAX_BLOCKS> stage2{};
+  size_t count = 0;
+};
+
+template <size_t L>
+constexpr Builder build(const std::array<Layer, L> &layers, uint8_t fallback) {
+  Builder t{};
+  std::array<int, 256> uniform{}; // value -> block holding only that value
+  uniform.fill(-1);
+
+  auto add = [&](const Block &block) {
+    for (size_t i = 0; i < t.count; ++i) {
+      if (t.stage2[i] == block)
+        return i;
+    }
+    if (t.count == MAX_BLOCKS)
+      throw "too many distinct blocks";
+    t.stage2[t.count] = block;
+    return t.count++;
+  };
+
+  auto add_uniform = [&](uint8_t value) {
+    if (uniform[value] < 0) {
+      Block block{};
+      block.fill(value);
+      uniform[value] = static_cast<int>(add(block));
+    }
+    return static_cast<size_t>(uniform[value]);
+  };
+
+  for (size_t b = 0; b < BLOCKS; ++b) {
+    char32_t lo = static_cast<char32_t>(b << BLOCK_BITS);
+    char32_t hi = static_cast<char32_t>(lo + BLOCK_SIZE - 1);
+
+    // The last layer touching the block decides whether it is uniform.
+    int top = -1;
+    size_t top_range = 0;
+    for (size_t l = 0; l < L; ++l) {
+      size_t i = lower_bound(layers[l], lo);
+      if (i < layers[l].count && layers[l].ranges[i].first <= hi) {
+        top = static_cast<int>(l);
+        top_range = i;
+      }
+    }
+
+    if (top < 0) {
+      t.stage1[b] = static_cast<uint8_t>(add_uniform(fallback));
+      continue;
+    }
+    const Range &r = layers[top].ranges[top_range];
+    if (r.first <= lo && r.last >= hi) {
+      t.stage1[b] = static_cast<uint8_t>(add_uniform(layers[top].value));
+      continue;
+    }
+
+    Block block{};
+    block.fill(fallback);
+    for (const Layer &l : layers) {
+      for (size_t i = lower_bound(l, lo); i < l.count && l.ranges[i].first <= hi; ++i) {
+        char32_t from = l.ranges[i].first < lo ? lo : l.ranges[i].first;
+        char32_t to = l.ranges[i].last > hi ? hi : l.ranges[i].last;
+        for (char32_t cp = from; cp <= to; ++cp)
+          block[cp - lo] = l.value;
+      }
+    }
+    t.stage1[b] = static_cast<uint8_t>(add(block));
+  }
+  return t;
+}
+
+template <size_t U> struct Table {
+  std::array<uint8_t, BLOCKS> stage1{};
+  std::array<Block, U> stage2{};
+
+  constexpr uint8_t operator[](char32_t cp) const {
+    if (cp >= 0x110000)
+      cp = 0xFFFD;
+    return stage2[stage1[cp >> BLOCK_BITS]][cp & (BLOCK_SIZE - 1)];
+  }
+};
+
+// Trims the second level of a built table to the blocks it uses.
+template <const Builder &B> constexpr Table<B.count> trim() {
+  Table<B.count> t{};
+  t.stage1 = B.stage1;
+  for (size_t i = 0; i < B.count; ++i)
+    t.stage2[i] = B.stage2[i];
+  return t;
+}
+
+} // namespace utl::ucd
+
+#endif // UNICODE_TABLE_H
@@ -0,0 +1,136 @@
+#ifndef UTF8_DECODER_H
+#define UTF8_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Streaming UTF-8 decoder.
+//
+// Bytes arrive from the PTY in arbitrary pieces; feed() decodes each piece
+// as it comes and holds back at most three bytes of a sequence cut off at
+// the end, finishing it on the next call. Runs of ASCII are found a block
+// at a time (see ascii_prefix) and passed through without decoding.
+//
+// Malformed input decodes to U+FFFD, one per maximal ill-formed subpart
+// (the Unicode "substitution of maximal subparts" practice): an invalid
+// lead byte, a lone continuation byte, or a sequence broken off early each
+// become one replacement character, and decoding resumes at the byte that
+// broke the sequence.
+
+namespace utl {
+
+// Length of the leading run of ASCII bytes in `p[0, n)`.
+size_t ascii_prefix(const char *p, size_t n);
+
+class Utf8Decoder {
+public:
+  static constexpr char32_t REPLACEMENT = 0xFFFD;
+  static constexpr std::string_view REPLACEMENT_UTF8 = "\xEF\xBF\xBD";
+
+  // Calls emit(char32_t cp, std::string_view utf8) for every complete code
+  // point in `bytes`. `utf8` is the sequence's encoding, valid only for the
+  // duration of the call.
+  template <class Emit> void feed(std::string_view bytes, Emit &&emit) {
+    const char *p = bytes.data();
+    size_t n = bytes.size();
+    size_t i = 0;
+
+    while (i < n) {
+      if (held == 0) {
+        size_t run = ascii_prefix(p + i, n - i);
+        for (size_t end = i + run; i < end; ++i)
+          emit(static_cast<char32_t>(p[i]), std::string_view(p + i, 1));
+        if (i == n)
+          break;
+
+        unsigned char lead = static_cast<unsigned char>(p[i]);
+        need = sequence_length(lead);
+        if (need == 0) {
+          emit(REPLACEMENT, REPLACEMENT_UTF8);
+          ++i;
+          continue;
+        }
+
+        // Whole sequence in this piece: decode in place.
+        if (n - i >= need && valid_sequence(p + i, need)) {
+          emit(decode(p + i, need), std::string_view(p + i, need));
+          i += need;
+          continue;
+        }
+      }
+
+      // Byte-at-a-time: a sequence split across pieces or a broken one.
+      unsigned char c = static_cast<unsigned char>(p[i]);
+      if (held > 0 && !continues(static_cast<unsigned char>(partial[0]), held, c)) {
+        held = 0;
+        emit(REPLACEMENT, REPLACEMENT_UTF8);
+        continue;   // `c` starts afresh
+      }
+      partial[held++] = static_cast<char>(c);
+      ++i;
+      if (held == need) {
+        emit(decode(partial, need), std::string_view(partial, need));
+        held = 0;
+      }
+    }
+  }
+
+  // Bytes of an unfinished sequence held over from the last feed().
+  size_t pending() const { return held; }
+
+  void reset() { held = 0; }
+
+private:
+  char partial[4] = {};
+  uint8_t held = 0;   // bytes in `partial`
+  uint8_t need = 0;   // length of the sequence `partial` starts
+
+  static uint8_t sequence_length(unsigned char lead) {
+    if (lead >= 0xC2 && lead <= 0xDF)
+      return 2;
+    if (lead >= 0xE0 && lead <= 0xEF)
+      return 3;
+    if (lead >= 0xF0 && lead <= 0xF4)
+      return 4;
+    return 0;   // continuation byte, overlong lead or beyond U+10FFFF
+  }
+
+  // Whether `c` may follow `lead` as byte `pos` of a sequence. Restricting
+  // the second byte rules out overlongs, surrogates and values past
+  // U+10FFFF.
+  static bool continues(unsigned char lead, size_t pos, unsigned char c) {
+    if (pos == 1) {
+      switch (lead) {
+        case 0xE0: return c >= 0xA0 && c <= 0xBF;
+        case 0xED: return c >= 0x80 && c <= 0x9F;
+        case 0xF0: return c >= 0x90 && c <= 0xBF;
+        case 0xF4: return c >= 0x80 && c <= 0x8F;
+        default: break;
+      }
+    }
+    return (c & 0xC0) == 0x80;
+  }
+
+  static bool valid_sequence(const char *s, size_t len) {
+    unsigned char lead = static_cast<unsigned char>(s[0]);
+    for (size_t k = 1; k < len; ++k) {
+      if (!continues(lead, k, static_cast<unsigned char>(s[k])))
+        return false;
+    }
+    return true;
+  }
+
+  static char32_t decode(const char *s, size_t len) {
+    auto b = [s](size_t k) { return static_cast<char32_t>(static_cast<unsigned char>(s[k])); };
+    switch (len) {
+      case 2: return (b(0) & 0x1F) << 6 | (b(1) & 0x3F);
+      case 3: return (b(0) & 0x0F) << 12 | (b(1) & 0x3F) << 6 | (b(2) & 0x3F);
+      default: return (b(0) & 0x07) << 18 | (b(1) & 0x3F) << 12 | (b(2) & 0x3F) << 6 | (b(3) & 0x3F);
+    }
+  }
+};
+
+} // namespace utl
+
+#endif // UTF8_DECODER_H
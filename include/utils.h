@@ -3,12 +3,14 @@
 #include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace utl {
-unsigned int get_next_codepoint(const std::string &s, size_t &i);
-bool is_devanagari(unsigned int cp);
-std::vector<std::string> split_by_devanagari(const std::string &input);
+unsigned int get_next_codepoint(std::string_view s, size_t &i);
 std::vector<std::string> split_by_newline(const std::string &input);
 std::vector<std::string> split_by_space(const std::string &input);
+// $XDG_CACHE_HOME/sita, or ~/.cache/sita without it; empty if neither
+// variable is set.
+std::string cache_dir();
 } // namespace utl
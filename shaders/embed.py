@@ -0,0 +1,17 @@
+#!/usr/bin/env python3
+# Writes a shader's source into a C++ header as a string constant named
+# after the file: text.vert becomes `text_vert`.
+import os
+import sys
+
+source, header = sys.argv[1], sys.argv[2]
+name = os.path.basename(source).replace('.', '_').replace('-', '_')
+with open(source, encoding='utf-8') as f:
+    code = f.read()
+if ')glsl"' in code:
+    sys.exit(f'{source}: contains the raw string delimiter')
+
+with open(header, 'w', encoding='utf-8') as f:
+    f.write(f'// Generated from {os.path.basename(source)} by shaders/embed.py\n')
+    f.write('#pragma once\n\n')
+    f.write(f'inline constexpr char {name}[] = R"glsl({code})glsl";\n')
@@ -4,9 +4,22 @@ out vec4 color;
 
 uniform sampler2D text;
 uniform vec3 textColor;
+// Colour table, one texel per slot; textColor is used when paletteSlot < 0.
+uniform sampler2D palette;
+uniform int paletteSlot;
+// The texture holds signed distance fields: 0.5 on the outline, more inside.
+uniform bool sdf;
 
 void main()
 {    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    float value = texture(text, TexCoords).r;
+    if (sdf) {
+        // Blend over about one screen pixel, whatever the scale
+        float width = max(fwidth(value) * 0.75, 1e-4);
+        value = smoothstep(0.5 - width, 0.5 + width, value);
+    }
+    vec3 rgb = paletteSlot < 0 ? textColor
+                               : texelFetch(palette, ivec2(paletteSlot, 0), 0).rgb;
+    vec4 sampled = vec4(1.0, 1.0, 1.0, value);
+    color = vec4(rgb, 1.0) * sampled;
 }
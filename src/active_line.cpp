@@ -0,0 +1,344 @@
+#include "active_line.h"
+#include "grapheme.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// The cluster of `s` covering cell `k`: it spans bytes [begin, end) and
+// starts at cell `cell`, which is k - 1 for a wide cluster straddling k.
+// Past the text all three are the end. Marks stay with their base.
+struct Split {
+    size_t begin;
+    size_t end;
+    size_t cell;
+};
+
+Split split_at(std::string_view s, size_t k) {
+    size_t n = 0;
+    for (size_t i = 0; i < s.size();) {
+        size_t at = i;
+        size_t w = utl::next_cluster(s, i);
+        if (w > 0 && n + w > k)
+            return {at, i, n};
+        n += w;
+    }
+    return {s.size(), s.size(), n};
+}
+
+// Moves `i` forward to a code point boundary: a chunk never starts with a
+// continuation byte (a lone one stays with the chunk before it).
+size_t chunk_end(const std::string& s, size_t i) {
+    while (i < s.size() && (static_cast<unsigned char>(s[i]) & 0xC0) == 0x80)
+        ++i;
+    return i;
+}
+
+} // namespace
+
+void ActiveLine::apply(const TerminalAction& a) {
+    switch (a.type) {
+        case ActionType::PRINT_TEXT:
+            write(a.text, a.attributes);
+            break;
+
+        case ActionType::CARRIAGE_RETURN:
+            carriage_return();
+            break;
+
+        case ActionType::BACKSPACE:
+            move(-1);
+            break;
+
+        case ActionType::CLEAR_LINE:
+            erase(a.row);
+            break;
+
+        case ActionType::MOVE_CURSOR:
+            // Only horizontal relative moves (CUF/CUB) make sense here.
+            if (!a.flag && a.row == 0)
+                move(a.col);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void ActiveLine::write(const std::string& bytes, const TerminalAttributes& attr) {
+    // A read can end inside a UTF-8 sequence: hold it back for the next one.
+    const std::string* in = &bytes;
+    std::string decoded;
+    if (utf8.pending() > 0 || utl::ascii_prefix(bytes.data(), bytes.size()) < bytes.size()) {
+        decoded.reserve(bytes.size());
+        utf8.feed(bytes, [&](char32_t, std::string_view ch) { decoded += ch; });
+        in = &decoded;
+    }
+    const std::string& text = *in;
+    if (text.empty())
+        return;
+
+    if (col > len) {
+        append(std::string(col - len, ' '), TerminalAttributes{});
+        len = col;
+    }
+
+    if (col == len) {
+        // Marks and joiners may extend the cluster already at the end.
+        size_t n = current.segments.empty()
+                   ? utl::text_width(text)
+                   : utl::appended_width(current.segments.back().content, text);
+        append(text, attr);
+        len += n;
+        col += n;
+        return;
+    }
+
+    // Overwrite: the new text replaces as many cells as it takes.
+    size_t n = utl::text_width(text);
+    invalidate(col);
+    std::vector<Segment> tail = cut(col);
+    drop_front(tail, n);
+    append(text, attr);
+    for (const auto& seg : tail)
+        append(seg.content, seg.attributes);
+
+    col += n;
+    len = std::max(len, col);
+}
+
+void ActiveLine::move(int n) {
+    if (n < 0 && static_cast<size_t>(-n) > col)
+        col = 0;
+    else
+        col += n;
+}
+
+// EL: 0 erases from the cursor to the end, 1 from the start to the cursor,
+// 2 the whole line. The cursor does not move.
+void ActiveLine::erase(int mode) {
+    switch (mode) {
+        case 0:
+            if (col < len) {
+                invalidate(col);
+                cut(col);
+                len = col;
+            }
+            break;
+
+        case 1: {
+            size_t n = std::min(col + 1, len);
+            invalidate(0);
+            std::vector<Segment> tail = cut(n);
+            current.segments.clear();
+            append(std::string(n, ' '), TerminalAttributes{});
+            for (const auto& seg : tail)
+                append(seg.content, seg.attributes);
+        } break;
+
+        case 2:
+            invalidate(0);
+            current.segments.clear();
+            len = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void ActiveLine::clear() {
+    current = ParsedLine{};
+    utf8.reset();
+    len = 0;
+    col = 0;
+    invalidate(0);
+}
+
+void ActiveLine::append(const std::string& text, const TerminalAttributes& attr) {
+    if (text.empty())
+        return;
+
+    size_t pos = 0;
+
+    if (!current.segments.empty()) {
+        auto& last = current.segments.back();
+
+        auto same_color = [](const TerminalColor& a, const TerminalColor& b) {
+            return a.type == b.type &&
+                   a.ansi_color == b.ansi_color &&
+                   a.indexed_color == b.indexed_color &&
+                   a.r == b.r && a.g == b.g && a.b == b.b;
+        };
+
+        bool same_fg = same_color(last.attributes.foreground, attr.foreground);
+        bool same_bg = same_color(last.attributes.background, attr.background);
+
+        if (same_fg && same_bg && last.attributes.bold == attr.bold) {
+            size_t room = CHUNK_BYTES - std::min(last.content.size(), CHUNK_BYTES);
+            pos = chunk_end(text, std::min(text.size(), room));
+            last.content.append(text, 0, pos);
+        }
+    }
+
+    while (pos < text.size()) {
+        size_t end = chunk_end(text, std::min(text.size(), pos + CHUNK_BYTES));
+        current.segments.push_back({text.substr(pos, end - pos), attr});
+        pos = end;
+    }
+}
+
+// Splits the line at cell `at`; returns everything after it.
+std::vector<Segment> ActiveLine::cut(size_t at) {
+    auto& segs = current.segments;
+    size_t seen = 0;
+
+    for (size_t i = 0; i < segs.size(); ++i) {
+        size_t n = utl::text_width(segs[i].content);
+        if (seen + n <= at) {
+            seen += n;
+            continue;
+        }
+
+        std::string& content = segs[i].content;
+        Split split = split_at(content, at - seen);
+        std::vector<Segment> tail;
+        if (split.cell < at - seen) {
+            // Cut through a wide cluster: both halves become blanks.
+            tail.push_back({" " + content.substr(split.end), segs[i].attributes});
+            content.replace(split.begin, std::string::npos, " ");
+        } else {
+            tail.push_back({content.substr(split.begin), segs[i].attributes});
+            content.resize(split.begin);
+        }
+        tail.insert(tail.end(),
+                    std::make_move_iterator(segs.begin() + i + 1),
+                    std::make_move_iterator(segs.end()));
+
+        segs.erase(segs.begin() + i + 1, segs.end());
+        if (content.empty())
+            segs.pop_back();
+        return tail;
+    }
+    return {};
+}
+
+// ------------------------------------------------------------
+// Wrap index
+// ------------------------------------------------------------
+
+size_t ActiveLine::rows(size_t cols) const {
+    index(cols);
+    return wrap_rows;
+}
+
+ActiveLine::Position ActiveLine::row_start(size_t cols, size_t row) const {
+    index(cols);
+    row = std::min(row, wrap_rows - 1);
+
+    // Walk forward from the nearest checkpoint, breaking rows the way
+    // index() does.
+    Position p = wrap[row / WRAP_STRIDE];
+    size_t breaks = row % WRAP_STRIDE;
+    size_t used = 0;
+    utl::GraphemeBreaker breaker;
+    const auto& segs = current.segments;
+
+    while (breaks > 0 && p.segment < segs.size()) {
+        std::string_view s = segs[p.segment].content;
+        while (p.byte < s.size()) {
+            size_t next = p.byte;
+            size_t w = utl::next_cell(breaker, s, next);
+            if (used > 0 && used + w > wrap_cols && breaker.at_boundary()) {
+                if (--breaks == 0)
+                    return p;
+                used = 0;
+            }
+            used += w;
+            p.cell += w;
+            p.byte = next;
+        }
+        ++p.segment;
+        p.byte = 0;
+    }
+    if (p.segment >= segs.size() && !segs.empty()) {
+        p.segment = segs.size() - 1;
+        p.byte = segs.back().content.size();
+    }
+    return p;
+}
+
+// Extends the index over text appended since the last call.
+void ActiveLine::index(size_t cols) const {
+    cols = std::max<size_t>(cols, 1);
+    if (cols != wrap_cols || wrap.empty()) {
+        wrap_cols = cols;
+        wrap.assign(1, Position{});
+        wrap_rows = 1;
+        scan = Position{};
+        scan_cells = 0;
+        scan_breaker.reset();
+    }
+
+    const auto& segs = current.segments;
+    while (scan.segment < segs.size()) {
+        std::string_view s = segs[scan.segment].content;
+        while (scan.byte < s.size()) {
+            size_t next = scan.byte;
+            size_t w = utl::next_cell(scan_breaker, s, next);
+            // A cluster that does not fit starts the next row.
+            if (scan_cells > 0 && scan_cells + w > cols && scan_breaker.at_boundary()) {
+                if (wrap_rows % WRAP_STRIDE == 0)
+                    wrap.push_back(scan);
+                ++wrap_rows;
+                scan_cells = 0;
+            }
+            scan_cells += w;
+            scan.cell += w;
+            scan.byte = next;
+        }
+        // The last chunk may still grow; resume inside it next time.
+        if (scan.segment + 1 == segs.size())
+            break;
+        ++scan.segment;
+        scan.byte = 0;
+    }
+}
+
+// Text from cell `cell` on is about to change. Checkpoints before it keep
+// their positions: edits only touch the line from `cell` onwards.
+void ActiveLine::invalidate(size_t cell) {
+    while (wrap.size() > 1 && wrap.back().cell >= cell)
+        wrap.pop_back();
+    if (wrap.empty() || cell == 0) {
+        wrap.clear();
+        return;
+    }
+    wrap_rows = (wrap.size() - 1) * WRAP_STRIDE + 1;
+    scan = wrap.back();
+    scan_cells = 0;
+    scan_breaker.reset();
+}
+
+void ActiveLine::drop_front(std::vector<Segment>& segments, size_t n) {
+    size_t drop = 0;
+    while (n > 0 && drop < segments.size()) {
+        std::string& content = segments[drop].content;
+        size_t count = utl::text_width(content);
+        if (count <= n) {
+            n -= count;
+            ++drop;
+        } else {
+            // The last dropped cell may be half of a wide cluster; the
+            // other half is left blank.
+            Split split = split_at(content, n);
+            if (split.cell < n)
+                content.replace(0, split.end, " ");
+            else
+                content.erase(0, split.begin);
+            n = 0;
+        }
+    }
+    segments.erase(segments.begin(), segments.begin() + drop);
+}
@@ -0,0 +1,117 @@
+#include "font_fallback.h"
+
+#ifdef HAVE_FONTCONFIG
+#include <fontconfig/fontconfig.h>
+#endif
+
+FontFallback::FontFallback(std::vector<std::string> paths, Opener open)
+    : cache(PAGES), open(std::move(open)) {
+  if (paths.size() > MAX_FONTS)
+    paths.resize(MAX_FONTS);
+  for (std::string &path : paths)
+    fonts.emplace_back(std::move(path));
+}
+
+void FontFallback::Coverage::build(FT_Face face) {
+  page_of.assign(PAGES, 0);
+  pages.clear();
+
+  FT_UInt glyph;
+  for (FT_ULong cp = FT_Get_First_Char(face, &glyph); glyph != 0;
+       cp = FT_Get_Next_Char(face, cp, &glyph)) {
+    if (cp >= 0x110000)
+      break;
+    uint16_t &page = page_of[cp >> 8];
+    if (page == 0) {
+      pages.push_back({});
+      page = static_cast<uint16_t>(pages.size());
+    }
+    pages[page - 1][(cp & 0xFF) >> 6] |= uint64_t{1} << (cp & 63);
+  }
+}
+
+// Opens font `index` the first time it is asked about.
+bool FontFallback::covers(size_t index, char32_t cp) {
+  Font &font = fonts[index];
+  if (!font.opened) {
+    font.opened = true;
+    if (FT_Face face = open(index, font.path, font.face_index)) {
+      font.coverage.build(face);
+      font.usable = true;
+    }
+  }
+  return font.usable && font.coverage.has(cp);
+}
+
+size_t FontFallback::resolve(char32_t cp) {
+  size_t index = 0;
+  for (; index < fonts.size(); ++index)
+    if (covers(index, cp))
+      break;
+
+  if (index == fonts.size())
+    index = discover(cp);
+
+  remember(cp, index);
+  return index;
+}
+
+void FontFallback::remember(char32_t cp, size_t index) {
+  std::unique_ptr<Page> &page = cache[cp >> 8];
+  if (!page)
+    page = std::make_unique<Page>();   // zeroed: nothing decided
+  (*page)[cp & 0xFF] = static_cast<uint8_t>(index + 1);
+}
+
+// Asks fontconfig for a font with `cp` and appends it to the chain.
+// Returns its index, or 0 when there is none.
+size_t FontFallback::discover(char32_t cp) {
+#ifdef HAVE_FONTCONFIG
+  // Controls and spaces are never drawn from a fallback.
+  if (!discovery || cp < 0x20 || cp == 0x7F || fonts.size() >= MAX_FONTS)
+    return 0;
+
+  FcCharSet *chars = FcCharSetCreate();
+  FcCharSetAddChar(chars, cp);
+  FcPattern *pattern = FcPatternCreate();
+  FcPatternAddCharSet(pattern, FC_CHARSET, chars);
+  FcPatternAddBool(pattern, FC_SCALABLE, FcTrue);
+  FcConfigSubstitute(nullptr, pattern, FcMatchPattern);
+  FcDefaultSubstitute(pattern);
+
+  FcResult result;
+  FcPattern *match = FcFontMatch(nullptr, pattern, &result);
+  FcPatternDestroy(pattern);
+  FcCharSetDestroy(chars);
+  if (!match)
+    return 0;
+
+  // The best match is returned even if it lacks the character.
+  FcCharSet *found = nullptr;
+  FcChar8 *file = nullptr;
+  int face_index = 0;
+  size_t index = 0;
+  if (FcPatternGetCharSet(match, FC_CHARSET, 0, &found) == FcResultMatch &&
+      FcCharSetHasChar(found, cp) &&
+      FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch) {
+    FcPatternGetInteger(match, FC_INDEX, 0, &face_index);
+    std::string path(reinterpret_cast<const char *>(file));
+
+    bool known = false;
+    for (const Font &font : fonts)
+      known |= font.path == path && font.face_index == face_index;
+
+    // A font already in the chain was found not to cover `cp`.
+    if (!known) {
+      fonts.emplace_back(path, face_index);
+      if (covers(fonts.size() - 1, cp))
+        index = fonts.size() - 1;
+    }
+  }
+  FcPatternDestroy(match);
+  return index;
+#else
+  (void)cp;
+  return 0;
+#endif
+}
@@ -0,0 +1,96 @@
+#include "font_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <print>
+#include <unordered_map>
+
+namespace {
+
+std::mutex registry_mutex;
+// Live mappings by path; an entry expires with the last user.
+std::unordered_map<std::string, std::weak_ptr<const FontFile>> registry;
+
+uint64_t mix(uint64_t h, uint64_t word) {
+  h ^= word;
+  h *= 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 29);
+}
+
+} // namespace
+
+FontFile::~FontFile() {
+  munmap(const_cast<unsigned char *>(bytes), length);
+}
+
+std::shared_ptr<const FontFile> FontFile::open(const std::string &path) {
+  std::lock_guard lock(registry_mutex);
+  if (auto it = registry.find(path); it != registry.end())
+    if (auto mapped = it->second.lock())
+      return mapped;
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::println(std::cerr, "ERROR::FONT: Could not map {}", path);
+    return nullptr;
+  }
+
+  std::shared_ptr<const FontFile> mapped(
+      new FontFile(path, static_cast<const unsigned char *>(data), size));
+  registry[path] = mapped;
+  return mapped;
+}
+
+// Eight bytes at a time; never 0, so callers can use 0 for "none".
+uint64_t FontFile::hash() const {
+  std::call_once(hashed, [this] {
+    uint64_t h = mix(0xCBF29CE484222325ull, length);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i, sizeof word);
+      h = mix(h, word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, length - i);
+    h = mix(h, tail);
+    content_hash = h ? h : 1;
+  });
+  return content_hash;
+}
+
+FT_Face FontFile::new_face(FT_Library library, long face_index) const {
+  FT_Face face;
+  if (!library || FT_New_Memory_Face(library, bytes, static_cast<FT_Long>(length),
+                                     face_index, &face))
+    return nullptr;
+  return face;
+}
+
+FT_Library shared_ft_library() {
+  static FT_Library library = [] {
+    FT_Library ft;
+    if (FT_Init_FreeType(&ft)) {
+      std::println(std::cerr, "ERROR::FREETYPE: Could not init FreeType Library");
+      return FT_Library{};
+    }
+    return ft;
+  }();
+  return library;
+}
@@ -0,0 +1,288 @@
+#include "glyph_atlas.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <print>
+
+namespace {
+
+// Zeros for a whole page, so new and reused pages start out clean
+const unsigned char *blank_page() {
+  static const std::vector<unsigned char> blank(GlyphAtlas::PAGE_BYTES);
+  return blank.data();
+}
+
+} // namespace
+
+GlyphAtlas::~GlyphAtlas() {
+  for (Page &page : pages)
+    if (page.texture)
+      glDeleteTextures(1, &page.texture);
+  if (pbo)
+    glDeleteBuffers(1, &pbo);
+}
+
+void GlyphAtlas::set_budget(size_t bytes) {
+  max_pages = std::clamp<size_t>(bytes / PAGE_BYTES, 1, NO_PAGE / 2);
+}
+
+const Character *GlyphAtlas::find(unsigned int font_index,
+                                  unsigned int glyph_id) {
+  uint64_t key = key_of(font_index, glyph_id);
+  if (!slots.empty()) {
+    Slot &slot = slot_for(key);
+    if (slot.key == key && live(slot)) {
+      if (slot.page != NO_PAGE)
+        pages[slot.page].used = frame;
+      ++counters.hits;
+      return &slot.glyph;
+    }
+  }
+  return nullptr;
+}
+
+void GlyphAtlas::insert(const std::vector<GlyphBitmap> &bitmaps) {
+  // Everything is placed (possibly wiping evicted pages) before the pixel
+  // buffer is bound, since uploads from client memory need it unbound.
+  uploads.clear();
+  for (const GlyphBitmap &bitmap : bitmaps)
+    place_glyph(bitmap);
+  upload();
+}
+
+void GlyphAtlas::place_glyph(const GlyphBitmap &bitmap) {
+  uint64_t key = key_of(bitmap.font_index, bitmap.glyph_id);
+  if (slots.empty())
+    grow();
+  Slot *slot = &slot_for(key);
+  if (slot->key != key) {
+    if ((filled + 1) * 4 > slots.size() * 3) {
+      grow();
+      slot = &slot_for(key);
+    }
+    slot->key = key;
+    ++filled;
+  }
+  ++counters.misses;
+
+  int w = bitmap.width;
+  int h = bitmap.rows;
+  Character glyph = {0, w, h, bitmap.left, bitmap.top, bitmap.advance,
+                     0.0f, 0.0f, 0.0f, 0.0f};
+  slot->page = NO_PAGE;
+
+  if (w + PADDING > PAGE_SIZE || h + PADDING > PAGE_SIZE) {
+    std::println(std::cerr, "Glyph {} of font {} is too large for the atlas",
+                 bitmap.glyph_id, bitmap.font_index);
+    glyph.width = glyph.height = 0;
+  } else if (w > 0 && h > 0) {
+    int x, y;
+    size_t index = page_for(w, h, x, y);
+    Page &page = pages[index];
+    uploads.push_back({&bitmap, page.texture, x, y});
+
+    const float size = static_cast<float>(PAGE_SIZE);
+    glyph.texture_id = page.texture;
+    glyph.u0 = x / size;
+    glyph.v0 = y / size;
+    glyph.u1 = (x + w) / size;
+    glyph.v1 = (y + h) / size;
+
+    page.used = frame;
+    slot->page = static_cast<uint16_t>(index);
+    slot->generation = page.generation;
+  }
+
+  slot->glyph = glyph;
+}
+
+// Copies the placed bitmaps into a freshly orphaned pixel buffer and
+// updates the pages from offsets into it.
+void GlyphAtlas::upload() {
+  if (uploads.empty())
+    return;
+
+  size_t bytes = 0;
+  for (const Upload &up : uploads)
+    bytes += up.bitmap->pixels.size();
+
+  if (!pbo)
+    glGenBuffers(1, &pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr,
+               GL_STREAM_DRAW);
+  auto *mapped = static_cast<unsigned char *>(glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  if (!mapped)
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);   // upload from memory instead
+
+  std::vector<size_t> offsets;
+  offsets.reserve(uploads.size());
+  size_t offset = 0;
+  for (const Upload &up : uploads) {
+    offsets.push_back(offset);
+    if (mapped)
+      std::memcpy(mapped + offset, up.bitmap->pixels.data(),
+                  up.bitmap->pixels.size());
+    offset += up.bitmap->pixels.size();
+  }
+  if (mapped)
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < uploads.size(); ++i) {
+    const Upload &up = uploads[i];
+    const void *source = mapped ? reinterpret_cast<const void *>(offsets[i])
+                                : up.bitmap->pixels.data();
+    glBindTexture(GL_TEXTURE_2D, up.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, up.x, up.y, up.bitmap->width,
+                    up.bitmap->rows, GL_RED, GL_UNSIGNED_BYTE, source);
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  uploads.clear();
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> GlyphAtlas::glyphs() const {
+  std::vector<std::pair<unsigned int, unsigned int>> out;
+  for (const Slot &slot : slots)
+    if (slot.key != 0 && live(slot))
+      out.emplace_back(static_cast<unsigned int>((slot.key >> 32) - 1),
+                       static_cast<unsigned int>(slot.key));
+  return out;
+}
+
+void GlyphAtlas::next_frame() {
+  ++frame;
+
+  // Give back the least recently used pages beyond the budget
+  while (counters.pages > max_pages) {
+    Page *oldest = nullptr;
+    for (Page &page : pages)
+      if (page.texture && (!oldest || page.used < oldest->used))
+        oldest = &page;
+    glDeleteTextures(1, &oldest->texture);
+    oldest->texture = 0;
+    clear_page(*oldest);
+    --counters.pages;
+    ++counters.evictions;
+  }
+}
+
+// Linear probing from the key's hash: the slot holding `key`, or the empty
+// slot where it would go.
+GlyphAtlas::Slot &GlyphAtlas::slot_for(uint64_t key) {
+  size_t mask = slots.size() - 1;
+  size_t i = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+  while (slots[i].key != key && slots[i].key != 0)
+    i = (i + 1) & mask;
+  return slots[i];
+}
+
+// Rehashes the live entries into a table at most a quarter full.
+void GlyphAtlas::grow() {
+  std::vector<Slot> old = std::move(slots);
+  size_t live_count = 0;
+  for (const Slot &slot : old)
+    live_count += slot.key != 0 && live(slot);
+
+  slots.assign(std::max<size_t>(1024, std::bit_ceil(live_count * 4)), Slot{});
+  filled = 0;
+  for (const Slot &slot : old) {
+    if (slot.key == 0 || !live(slot))
+      continue;
+    slot_for(slot.key) = slot;
+    ++filled;
+  }
+}
+
+// Finds room on the shelf closest in height to the glyph, or opens a new
+// shelf below the others.
+bool GlyphAtlas::place(Page &page, int w, int h, int &x, int &y) {
+  w += PADDING;
+  h += PADDING;
+
+  Shelf *best = nullptr;
+  for (Shelf &shelf : page.shelves)
+    if (shelf.height >= h && shelf.x + w <= PAGE_SIZE &&
+        (!best || shelf.height < best->height))
+      best = &shelf;
+
+  if (!best || best->height > h * 2) {
+    if (page.next_y + h <= PAGE_SIZE) {
+      page.shelves.push_back({page.next_y, h, 0});
+      page.next_y += h;
+      best = &page.shelves.back();
+    } else if (!best) {
+      return false;
+    }
+  }
+
+  x = best->x;
+  y = best->y;
+  best->x += w;
+  return true;
+}
+
+size_t GlyphAtlas::page_for(int w, int h, int &x, int &y) {
+  for (size_t i = 0; i < pages.size(); ++i)
+    if (pages[i].texture && place(pages[i], w, h, x, y))
+      return i;
+
+  // Under budget, or the whole budget is in use this frame: take another
+  // page. Otherwise reuse the one drawn from longest ago.
+  size_t oldest = pages.size();
+  if (counters.pages >= max_pages) {
+    for (size_t i = 0; i < pages.size(); ++i)
+      if (pages[i].texture && pages[i].used != frame &&
+          (oldest == pages.size() || pages[i].used < pages[oldest].used))
+        oldest = i;
+  }
+
+  if (oldest < pages.size()) {
+    clear_page(pages[oldest]);
+    ++counters.evictions;
+  } else {
+    auto released = std::ranges::find(pages, 0u, &Page::texture);
+    oldest = static_cast<size_t>(released - pages.begin());
+    if (released == pages.end())
+      pages.emplace_back();
+    open_page(pages[oldest]);
+  }
+
+  place(pages[oldest], w, h, x, y);
+  return oldest;
+}
+
+void GlyphAtlas::open_page(Page &page) {
+  glGenTextures(1, &page.texture);
+  glBindTexture(GL_TEXTURE_2D, page.texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, PAGE_SIZE, PAGE_SIZE, 0, GL_RED,
+               GL_UNSIGNED_BYTE, blank_page());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  page.used = frame;
+  ++counters.pages;
+}
+
+// Forgets every glyph on the page; the old pixels are wiped so they cannot
+// bleed into the padding of new ones.
+void GlyphAtlas::clear_page(Page &page) {
+  page.shelves.clear();
+  page.next_y = 0;
+  ++page.generation;
+  if (page.texture) {
+    glBindTexture(GL_TEXTURE_2D, page.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PAGE_SIZE, PAGE_SIZE, GL_RED,
+                    GL_UNSIGNED_BYTE, blank_page());
+  }
+  page.used = frame;
+}
@@ -0,0 +1,189 @@
+#include "glyph_disk_cache.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <print>
+
+namespace {
+
+constexpr char MAGIC[8] = {'S', 'I', 'T', 'A', 'G', 'L', 'Y', 'F'};
+
+uint64_t mix(uint64_t h, uint64_t word) {
+  h ^= word;
+  h *= 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 29);
+}
+
+} // namespace
+
+GlyphDiskCache::~GlyphDiskCache() {
+  close();
+}
+
+bool GlyphDiskCache::open(const FontFile &font, long face_index,
+                          unsigned int size, bool sdf) {
+  close();
+
+  std::string dir = utl::cache_dir();
+  if (dir.empty())
+    return false;
+  font_hash = mix(font.hash(), static_cast<uint64_t>(face_index));
+  pixel_size = size;
+  flags = sdf ? FLAG_SDF : 0;
+  path = std::format("{}/glyphs-v{}-{:016x}-{}{}.bin", dir, VERSION, font_hash,
+                     pixel_size, sdf ? "-sdf" : "");
+
+  // No file yet is fine: save() writes the first one.
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return true;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+    map_size = static_cast<size_t>(st.st_size);
+    void *data = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    map = data == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(data);
+  }
+  ::close(fd);
+  if (!map)
+    return true;
+
+  // A file from another version or font, or a torn one, is ignored and
+  // replaced on save.
+  Header header;
+  std::memcpy(&header, map, sizeof header);
+  if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 ||
+      header.version != VERSION || header.pixel_size != pixel_size ||
+      header.font_hash != font_hash || header.flags != flags ||
+      header.count > (map_size - sizeof(Header)) / sizeof(Entry)) {
+    munmap(const_cast<uint8_t *>(map), map_size);
+    map = nullptr;
+    map_size = 0;
+    return true;
+  }
+
+  entries = reinterpret_cast<const Entry *>(map + sizeof(Header));
+  count = header.count;
+  return true;
+}
+
+void GlyphDiskCache::close() {
+  if (map)
+    munmap(const_cast<uint8_t *>(map), map_size);
+  map = nullptr;
+  map_size = 0;
+  entries = nullptr;
+  count = 0;
+  added.clear();
+  path.clear();
+}
+
+const GlyphDiskCache::Entry *GlyphDiskCache::lookup(unsigned int glyph_id) const {
+  const Entry *end = entries + count;
+  const Entry *it = std::lower_bound(
+      entries, end, glyph_id,
+      [](const Entry &e, unsigned int id) { return e.glyph_id < id; });
+  return it != end && it->glyph_id == glyph_id ? it : nullptr;
+}
+
+// Whether the entry's pixels lie inside the mapping.
+bool GlyphDiskCache::in_bounds(const Entry &e) const {
+  if (e.width < 0 || e.rows < 0 || e.offset > map_size)
+    return false;
+  return size_t(e.width) * size_t(e.rows) <= map_size - e.offset;
+}
+
+bool GlyphDiskCache::find(unsigned int glyph_id, GlyphBitmap &out) const {
+  const Entry *e = map ? lookup(glyph_id) : nullptr;
+  if (!e || !in_bounds(*e))
+    return false;
+  size_t bytes = size_t(e->width) * size_t(e->rows);
+
+  out.glyph_id = glyph_id;
+  out.width = e->width;
+  out.rows = e->rows;
+  out.left = e->left;
+  out.top = e->top;
+  out.advance = e->advance;
+  out.pixels.assign(map + e->offset, map + e->offset + bytes);
+  return true;
+}
+
+void GlyphDiskCache::remember(const GlyphBitmap &bitmap) {
+  if (path.empty() || count + added.size() >= MAX_GLYPHS ||
+      (map && lookup(bitmap.glyph_id)))
+    return;
+  added.push_back(bitmap);
+}
+
+bool GlyphDiskCache::save() {
+  if (path.empty() || added.empty())
+    return true;
+
+  struct Item {
+    Entry entry;
+    const uint8_t *pixels;
+  };
+  std::vector<Item> items;
+  items.reserve(count + added.size());
+  for (size_t i = 0; i < count; ++i)
+    if (in_bounds(entries[i]))
+      items.push_back({entries[i], map + entries[i].offset});
+  for (const GlyphBitmap &b : added)
+    items.push_back({{b.glyph_id, b.width, b.rows, b.left, b.top, b.advance, 0},
+                     b.pixels.data()});
+  std::ranges::stable_sort(items, {}, [](const Item &it) { return it.entry.glyph_id; });
+  auto dup = std::ranges::unique(items, {}, [](const Item &it) { return it.entry.glyph_id; });
+  items.erase(dup.begin(), dup.end());
+
+  uint64_t offset = sizeof(Header) + items.size() * sizeof(Entry);
+  for (Item &item : items) {
+    item.entry.offset = offset;
+    offset += uint64_t(item.entry.width) * uint64_t(item.entry.rows);
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+  // Written beside the old file and renamed over it, so a reader never
+  // sees half a file. Rasterizers retired in the background may save the
+  // same size at once, so each write has its own name.
+  static std::atomic<unsigned> writes{0};
+  std::string tmp = std::format("{}.{}.{}", path, getpid(), writes++);
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+  header.version = VERSION;
+  header.pixel_size = pixel_size;
+  header.font_hash = font_hash;
+  header.count = static_cast<uint32_t>(items.size());
+  header.flags = flags;
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  for (const Item &item : items)
+    out.write(reinterpret_cast<const char *>(&item.entry), sizeof(Entry));
+  for (const Item &item : items)
+    out.write(reinterpret_cast<const char *>(item.pixels),
+              std::streamsize(item.entry.width) * item.entry.rows);
+  out.close();
+
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::println(std::cerr, "ERROR::GLYPH_CACHE: Could not write {}: {}", path,
+                 std::strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+  added.clear();
+  return true;
+}
@@ -0,0 +1,203 @@
+#include "glyph_rasterizer.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MODULE_H
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <print>
+
+namespace {
+
+// Pixels of distance kept around the outline in distance-field mode.
+constexpr FT_Int SDF_SPREAD = 4;
+
+// Leaves the glyph's bitmap in face->glyph. Distance fields are made from
+// the coverage bitmap (FreeType's "bsdf" renderer), which is several times
+// faster than measuring from the outline and as good at this spread.
+bool render(FT_Face face, unsigned int glyph_id, bool sdf) {
+  if (FT_Load_Glyph(face, glyph_id, FT_LOAD_RENDER))
+    return false;
+  if (!sdf || face->glyph->bitmap.width == 0 || face->glyph->bitmap.rows == 0)
+    return true;
+  return !FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF);
+}
+
+} // namespace
+
+GlyphRasterizer::GlyphRasterizer(bool sdf, unsigned int threads) : sdf(sdf) {
+  threads = std::max(threads, 1u);
+  for (unsigned int i = 0; i < threads; ++i)
+    workers.emplace_back([this] { work(); });
+}
+
+GlyphRasterizer::~GlyphRasterizer() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  if (cancelled)
+    return;
+  for (auto &cache : disk)
+    if (cache)
+      cache->save();
+}
+
+void GlyphRasterizer::cancel() {
+  std::lock_guard lock(mutex);
+  cancelled = true;
+  jobs.clear();
+}
+
+// Half the cores, leaving the rest to the render and PTY threads.
+unsigned int GlyphRasterizer::default_threads() {
+  return std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+}
+
+void GlyphRasterizer::add_font(size_t index, std::shared_ptr<const FontFile> file,
+                               long face_index, unsigned int pixel_size) {
+  auto cache = std::make_unique<GlyphDiskCache>();
+  if (!file || !cache->open(*file, face_index, pixel_size, sdf))
+    cache.reset();
+
+  std::lock_guard lock(mutex);
+  if (index >= fonts.size()) {
+    fonts.resize(index + 1);
+    disk.resize(index + 1);
+  }
+  fonts[index] = {std::move(file), face_index, pixel_size};
+  disk[index] = std::move(cache);
+}
+
+void GlyphRasterizer::request(unsigned int font_index, unsigned int glyph_id) {
+  uint64_t key = uint64_t{font_index} << 32 | glyph_id;
+  if (!in_flight.insert(key).second)
+    return;
+
+  // Only this thread replaces caches, and lookups only read the mapping
+  GlyphBitmap bitmap{font_index, glyph_id, 0, 0, 0, 0, 0, {}};
+  const GlyphDiskCache *cache = font_index < disk.size() ? disk[font_index].get() : nullptr;
+  if (cache && cache->find(glyph_id, bitmap)) {
+    std::lock_guard lock(mutex);
+    finished.push_back(std::move(bitmap));
+    return;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    jobs.push_back({font_index, glyph_id});
+  }
+  wake.notify_one();
+}
+
+void GlyphRasterizer::collect(std::vector<GlyphBitmap> &out) {
+  if (in_flight.empty())
+    return;
+  size_t first = out.size();
+  {
+    std::lock_guard lock(mutex);
+    take_finished(out);
+  }
+  for (size_t i = first; i < out.size(); ++i)
+    in_flight.erase(uint64_t{out[i].font_index} << 32 | out[i].glyph_id);
+}
+
+void GlyphRasterizer::drain(std::vector<GlyphBitmap> &out) {
+  {
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+    take_finished(out);
+  }
+  in_flight.clear();
+}
+
+void GlyphRasterizer::take_finished(std::vector<GlyphBitmap> &out) {
+  std::move(finished.begin(), finished.end(), std::back_inserter(out));
+  finished.clear();
+}
+
+void GlyphRasterizer::work() {
+  // Without a library the worker still answers, with blank glyphs, so
+  // drain() cannot wait forever.
+  FT_Library library;
+  if (FT_Init_FreeType(&library)) {
+    std::println(std::cerr, "ERROR::FREETYPE: Could not init FreeType Library");
+    library = nullptr;
+  } else if (sdf) {
+    FT_Int spread = SDF_SPREAD;
+    FT_Property_Set(library, "bsdf", "spread", &spread);
+  }
+  std::vector<FT_Face> faces;   // this worker's own, by font index
+  std::vector<bool> opened;
+
+  std::unique_lock lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+    if (stopping)
+      break;
+    Job job = jobs.front();
+    jobs.pop_front();
+    ++running;
+    FontSource source =
+        job.font_index < fonts.size() ? fonts[job.font_index] : FontSource{};
+    lock.unlock();
+
+    if (job.font_index >= faces.size()) {
+      faces.resize(job.font_index + 1, nullptr);
+      opened.resize(job.font_index + 1, false);
+    }
+    FT_Face &face = faces[job.font_index];
+    if (!opened[job.font_index]) {
+      opened[job.font_index] = true;
+      face = source.file ? source.file->new_face(library, source.face_index)
+                         : nullptr;
+      if (face)
+        FT_Set_Pixel_Sizes(face, 0, source.pixel_size);
+    }
+
+    // A glyph that fails comes back blank, so it is not asked for again.
+    GlyphBitmap bitmap{job.font_index, job.glyph_id, 0, 0, 0, 0, 0, {}};
+    bool rendered = face && render(face, job.glyph_id, sdf);
+    if (rendered) {
+      const FT_GlyphSlot slot = face->glyph;
+      bitmap.width = static_cast<int>(slot->bitmap.width);
+      bitmap.rows = static_cast<int>(slot->bitmap.rows);
+      bitmap.left = slot->bitmap_left;
+      bitmap.top = slot->bitmap_top;
+      bitmap.advance = static_cast<unsigned int>(slot->advance.x >> 6);
+
+      size_t width = slot->bitmap.width;
+      size_t pitch = static_cast<size_t>(std::abs(slot->bitmap.pitch));
+      bitmap.pixels.resize(width * slot->bitmap.rows);
+      for (size_t row = 0; row < slot->bitmap.rows; ++row)
+        std::memcpy(bitmap.pixels.data() + row * width,
+                    slot->bitmap.buffer + row * pitch, width);
+    } else {
+      std::println(std::cerr,
+                   "ERROR::FREETYPE: Failed to load Glyph {} for font index {}",
+                   job.glyph_id, job.font_index);
+    }
+
+    lock.lock();
+    // Only real renders go to disk; a failure may be transient (a face
+    // that could not be opened this run) and must not outlive the session.
+    if (rendered && job.font_index < disk.size() && disk[job.font_index])
+      disk[job.font_index]->remember(bitmap);
+    finished.push_back(std::move(bitmap));
+    if (--running == 0 && jobs.empty())
+      idle.notify_all();
+  }
+  lock.unlock();
+
+  for (FT_Face face : faces)
+    if (face)
+      FT_Done_Face(face);
+  if (library)
+    FT_Done_FreeType(library);
+}
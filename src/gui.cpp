@@ -4,12 +4,17 @@
 #include <GLFW/glfw3native.h>
 #endif
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <print>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "gui.h"
+#include "startup_timeline.h"
 
 namespace {
 
@@ -34,6 +39,66 @@ std::string utf8_encode(unsigned int cp) {
     return out;
 }
 
+// The main font followed by its fallbacks. SITA_FONT replaces the main
+// font; SITA_FALLBACK_FONTS is a colon-separated list that replaces the
+// fallbacks.
+std::vector<std::string> font_chain() {
+    std::vector<std::string> fonts = {
+        "/home/pranphy/.local/share/fonts/iosevka/IosevkaTermSlabNerdFont-Regular.ttf",
+        "/home/pranphy/.local/share/fonts/devanagari/NotoSerif/"
+        "NotoSerifDevanagari-Regular.ttf",
+    };
+
+    if (const char* main = std::getenv("SITA_FONT"); main && *main)
+        fonts[0] = main;
+
+    if (const char* list = std::getenv("SITA_FALLBACK_FONTS")) {
+        fonts.resize(1);
+        std::string_view rest = list;
+        while (!rest.empty()) {
+            size_t colon = std::min(rest.find(':'), rest.size());
+            if (colon > 0)
+                fonts.emplace_back(rest.substr(0, colon));
+            rest.remove_prefix(std::min(colon + 1, rest.size()));
+        }
+    }
+    return fonts;
+}
+
+// Builds the text renderer on another thread. It needs no GL context until
+// init_gl(), which mainloop() calls once the window exists.
+std::future<std::unique_ptr<TextRenderer>> load_renderer() {
+    // SITA_STARTUP_TIMELINE=1 prints when each part of startup ran, up to
+    // the first frame showing shell output.
+    if (const char* timeline = std::getenv("SITA_STARTUP_TIMELINE"))
+        StartupTimeline::get().set_enabled(std::string_view(timeline) == "1");
+
+    return std::async(std::launch::async, [] {
+        auto phase = StartupTimeline::get().phase("load fonts, queue prewarm");
+
+        // SITA_GLYPH_SDF=1 keeps glyphs as signed distance fields, drawn sharp
+        // at any scale.
+        const char* sdf = std::getenv("SITA_GLYPH_SDF");
+        auto renderer = std::make_unique<TextRenderer>(
+            font_chain(), sdf && std::string_view(sdf) == "1");
+        // SITA_FONT_DISCOVERY=0 keeps to the listed fonts, without asking
+        // fontconfig for characters none of them have.
+        if (const char* discovery = std::getenv("SITA_FONT_DISCOVERY"))
+            renderer->set_font_discovery(std::string_view(discovery) != "0");
+        // SITA_GLYPH_CACHE_MB bounds the texture memory kept for glyphs.
+        if (const char* budget = std::getenv("SITA_GLYPH_CACHE_MB"))
+            renderer->set_glyph_budget(size_t(std::max(1, std::atoi(budget))) << 20);
+
+        // Rasterize the glyphs a first screen is made of while the shell
+        // starts. SITA_PREWARM_DEVANAGARI replaces the Devanagari clusters
+        // among them (space-separated; empty for none).
+        const char* clusters = std::getenv("SITA_PREWARM_DEVANAGARI");
+        renderer->prewarm(clusters ? std::string(clusters)
+                                   : TextRenderer::common_devanagari());
+        return renderer;
+    });
+}
+
 } // namespace
 
 
@@ -41,12 +106,34 @@ GLFWApp::GLFWApp()
     : terminal(1920, 1080),
       view(terminal)
 {
+    renderer_ready = load_renderer();
+    StartupTimeline::get().mark("shell spawned");
+
+    auto phase = StartupTimeline::get().phase("glfw init");
     if (!glfwInit())
         throw std::runtime_error("Failed to initialize GLFW");
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_CORE_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // SITA_LAZY_HISTORY=1 stores main-screen output as raw bytes.
+    if (const char* lazy = std::getenv("SITA_LAZY_HISTORY"))
+        terminal.set_lazy_history(std::string_view(lazy) == "1");
+
+    // SITA_SCROLLBACK_FILE=1 keeps unlimited history in a temporary file,
+    // SITA_SCROLLBACK_FILE=keep also leaves that file behind on exit; empty
+    // or 0 turns it off.
+    if (const char* mode = std::getenv("SITA_SCROLLBACK_FILE");
+        mode && *mode && std::string_view(mode) != "0") {
+        if (terminal.enable_disk_scrollback(std::string_view(mode) == "keep"))
+            terminal.set_scrollback_limits(0, Scrollback::DEFAULT_MAX_BYTES);
+    }
+
+    // SITA_RESIZE_DELAY_MS sets how long the window size must stay put
+    // before the grid and the PTY are resized (0 applies every resize).
+    if (const char* delay = std::getenv("SITA_RESIZE_DELAY_MS"))
+        resize_delay = std::max(0, std::atoi(delay)) / 1000.0;
 }
 
 GLFWApp::~GLFWApp() {
@@ -92,6 +179,7 @@ void GLFWApp::focus_callback(GLFWwindow* w, int focused) {
 // ------------------------------------------------------------
 
 int GLFWApp::create(int width, int height, const char* title) {
+    auto phase = StartupTimeline::get().phase("create window and GL context");
     window = glfwCreateWindow(width, height, title, nullptr, nullptr);
     if (!window) {
         std::println(std::cerr, "ERROR::GLFW: Failed to create window");
@@ -152,20 +240,42 @@ void GLFWApp::mainloop() {
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
 
-    text_renderer = std::make_unique<TextRenderer>();
+    StartupTimeline& timeline = StartupTimeline::get();
+    {
+        auto phase = timeline.phase("wait for fonts");
+        text_renderer = renderer_ready.get();
+    }
+    {
+        auto phase = timeline.phase("shaders and GL buffers");
+        text_renderer->init_gl();
+    }
     view.set_renderer(text_renderer.get());
     view.set_window_size(width, height);
+    frame_width  = width;
+    frame_height = height;
+
+    // Startup ends with the first frame that shows shell output
+    bool first_frame  = true;
+    bool shell_output = false;
+    bool prompt_shown = false;
 
     while (!glfwWindowShouldClose(window)) {
+        apply_pending_resize();
 
 #ifdef HAVE_WAYLAND
         if (wayland_input && wayland_input->is_valid())
             wl_display_dispatch_pending(glfwGetWaylandDisplay());
 #endif
 
-        if (terminal.poll_output().contains('\x04'))
+        std::string output = terminal.poll_output();
+        if (output.contains('\x04'))
             glfwSetWindowShouldClose(window, true);
+        if (!output.empty() && !shell_output) {
+            shell_output = true;
+            timeline.mark("first shell output");
+        }
 
+        auto frame_start = StartupTimeline::Clock::now();
         view.update_cursor_blink();
         view.render();
 
@@ -184,6 +294,16 @@ void GLFWApp::mainloop() {
 #endif
 
         glfwSwapBuffers(window);
+        if (first_frame) {
+            first_frame = false;
+            timeline.add("first frame (waits for prewarm)", frame_start,
+                         StartupTimeline::Clock::now());
+        }
+        if (shell_output && !prompt_shown) {
+            prompt_shown = true;
+            timeline.mark("first shell output on screen");
+            timeline.report();
+        }
         glfwPollEvents();
     }
 }
@@ -205,12 +325,51 @@ void GLFWApp::on_scroll(double, double y) {
     view.render();
 }
 
+// A window drag delivers dozens of sizes a second. Each would resize the
+// grid and send TIOCSWINSZ, making the shell or a full-screen app redraw
+// for every intermediate size, so only the last one is applied. Meanwhile
+// the current frame is drawn at its old size, pinned to the top-left.
 void GLFWApp::on_resize(int width, int height) {
-    glViewport(0, 0, width, height);
-    view.set_window_size(width, height);
+    pending_width  = width;
+    pending_height = height;
+    resize_at      = glfwGetTime();
+
+    if (resize_delay <= 0.0 || frame_width == 0) {
+        apply_pending_resize();
+    } else {
+        glViewport(0, height - frame_height, frame_width, frame_height);
+    }
     view.render();
 }
 
+// Runs on the main thread, so at most one grid reflow is in flight.
+void GLFWApp::apply_pending_resize() {
+    if (resize_at < 0.0 || glfwGetTime() - resize_at < resize_delay)
+        return;
+    resize_at = -1.0;
+
+    if (pending_width <= 0 || pending_height <= 0)
+        return;   // minimized
+
+    glViewport(0, 0, pending_width, pending_height);
+    view.set_window_size(pending_width, pending_height);
+    frame_width  = pending_width;
+    frame_height = pending_height;
+}
+
+// A zoom changes the grid the way a resize does, so the reflow and the
+// PTY resize wait for the same pause; holding Ctrl+= reflows once.
+void GLFWApp::zoom(int steps) {
+    view.zoom(steps);
+    if (resize_at < 0.0) {
+        pending_width  = frame_width;
+        pending_height = frame_height;
+    }
+    resize_at = glfwGetTime();
+    if (resize_delay <= 0.0)
+        apply_pending_resize();
+}
+
 void GLFWApp::on_char(unsigned int cp) {
     terminal.send_input(utf8_encode(cp));
 }
@@ -219,6 +378,18 @@ void GLFWApp::on_key_press(int key, int action, int mods) {
     if (action != GLFW_PRESS && action != GLFW_REPEAT)
         return;
 
+    // Ctrl+= / Ctrl+- / Ctrl+0 zoom the font
+    if (mods & GLFW_MOD_CONTROL) {
+        switch (key) {
+            case GLFW_KEY_EQUAL:
+            case GLFW_KEY_KP_ADD:      zoom(1);  return;
+            case GLFW_KEY_MINUS:
+            case GLFW_KEY_KP_SUBTRACT: zoom(-1); return;
+            case GLFW_KEY_0:
+            case GLFW_KEY_KP_0:        zoom(0);  return;
+        }
+    }
+
     // Ctrl+A..Z
     if (mods & GLFW_MOD_CONTROL) {
         if (key >= GLFW_KEY_A && key <= GLFW_KEY_Z) {
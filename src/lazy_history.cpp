@@ -0,0 +1,304 @@
+#include "lazy_history.h"
+#include "grapheme.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+LazyHistory::LazyHistory() = default;
+
+void LazyHistory::set_limits(size_t max_lines, size_t max_bytes) {
+    line_limit = max_lines;
+    byte_limit = max_bytes;
+    enforce_limits();
+}
+
+// ------------------------------------------------------------
+// Ingestion
+// ------------------------------------------------------------
+
+size_t LazyHistory::append_text(const char* data, size_t len,
+                                const TerminalAttributes& attrs) {
+    if (len == 0)
+        return 0;
+    if (groups.empty()) {
+        start_group(attrs);
+        tail_attrs = attrs;
+    }
+    touch_back();
+
+    const char* p   = data;
+    const char* end = data + len;
+    size_t finished = 0;
+
+    while (p < end) {
+        const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+        if (!nl) {
+            measure(p, end);
+            groups.back().bytes.append(p, static_cast<size_t>(end - p));
+            bytes += static_cast<size_t>(end - p);
+            break;
+        }
+
+        const char* next = static_cast<const char*>(nl) + 1;
+        measure(p, next - 1);
+        row_index.push_back(tail_cells, tail_wide);
+        tail_col = 0;
+        tail_cells = 0;
+        tail_breaker.reset();
+        tail_wide.clear();
+
+        groups.back().bytes.append(p, static_cast<size_t>(next - p));
+        bytes += static_cast<size_t>(next - p);
+        p = next;
+
+        ++count;
+        ++finished;
+
+        Group& back = groups.back();
+        if (back.line_starts.size() == GROUP_LINES) {
+            start_group(attrs);
+        } else {
+            back.line_starts.push_back(static_cast<uint32_t>(back.bytes.size()));
+            bytes += sizeof(uint32_t);
+        }
+    }
+
+    // Plain text cannot change attributes, so whatever was in effect for
+    // this run is also in effect where the last line starts.
+    if (finished) {
+        tail_attrs = attrs;
+        compacted_tail = 0;
+    }
+
+    enforce_limits();
+    return finished;
+}
+
+void LazyHistory::append_sequence(const char* data, size_t len) {
+    if (len == 0 || groups.empty())
+        return;
+    touch_back();
+    groups.back().bytes.append(data, len);
+    bytes += len;
+}
+
+void LazyHistory::compact_active(const TerminalAttributes& attrs) {
+    if (groups.empty())
+        return;
+
+    Group& back = groups.back();
+    size_t start = back.line_starts.back();
+    size_t tail  = back.bytes.size() - start;
+
+    // A long line without \r compacts to about its own size; waiting for
+    // the tail to double keeps that case linear.
+    if (tail < COMPACT_TAIL_BYTES || tail < 2 * compacted_tail)
+        return;
+
+    const ActiveLine& line = active();
+
+    std::string rebuilt;
+    for (const auto& seg : line.line().segments) {
+        rebuilt += TerminalParser::encode_attributes(seg.attributes);
+        rebuilt += seg.content;
+    }
+    if (line.cursor() != line.length()) {
+        rebuilt += '\r';
+        if (line.cursor() > 0)
+            rebuilt += "\033[" + std::to_string(line.cursor()) + "C";
+    }
+    rebuilt += TerminalParser::encode_attributes(attrs);
+
+    bytes -= tail;
+    back.bytes.resize(start);
+    back.bytes += rebuilt;
+    bytes += rebuilt.size();
+    compacted_tail = rebuilt.size();
+    touch_back();
+
+    // The rebuilt bytes replay to the line already held, ending in `attrs`.
+    active_parser.reset(attrs);
+    active_fed = back.bytes.size();
+}
+
+void LazyHistory::clear() {
+    groups.clear();
+    materialized.clear();
+    active_line.clear();
+    active_group = UINT64_MAX;
+    compacted_tail = 0;
+    row_index.clear();
+    tail_col = 0;
+    tail_cells = 0;
+    tail_breaker.reset();
+    tail_wide.clear();
+    head  = 0;
+    count = 0;
+    bytes = 0;
+}
+
+// A cluster of width `w` lands at tail_col: wide clusters it covers are
+// gone, and it may start one itself. Text rewritten after \r usually
+// reaches the end of the line, so forgetting everything past tail_col is
+// close enough for an estimate.
+void LazyHistory::overwrite_wide(size_t w) {
+    while (!tail_wide.empty() && tail_wide.back().cell >= tail_col)
+        tail_wide.pop_back();
+    if (!tail_wide.empty()) {
+        RowIndex::WideRun& last = tail_wide.back();
+        size_t end = last.cell + 2 * size_t{last.count};
+        if (end > tail_col)
+            last.count = static_cast<uint32_t>((tail_col - last.cell) / 2);
+        if (last.count == 0)
+            tail_wide.pop_back();
+    }
+
+    if (w != 2 || tail_col > UINT32_MAX)
+        return;
+    if (!tail_wide.empty() &&
+        tail_wide.back().cell + 2 * size_t{tail_wide.back().count} == tail_col)
+        ++tail_wide.back().count;
+    else
+        tail_wide.push_back({static_cast<uint32_t>(tail_col), 1});
+}
+
+void LazyHistory::measure(const char* p, const char* end) {
+    for (; p < end; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '\r') {
+            tail_col = 0;
+            tail_breaker.reset();
+        } else if (c == '\b') {
+            if (tail_col > 0)
+                --tail_col;
+            tail_breaker.reset();
+        } else if (c >= 0x20 && (c & 0xC0) != 0x80) {
+            size_t i = 0;
+            size_t w = utl::next_cell(tail_breaker,
+                                      std::string_view(p, static_cast<size_t>(end - p)), i);
+            if (w > 0 && tail_breaker.at_boundary())
+                overwrite_wide(w);
+            tail_col += w;
+            tail_cells = std::max(tail_cells, tail_col);
+        }
+    }
+}
+
+void LazyHistory::start_group(const TerminalAttributes& attrs) {
+    Group group;
+    group.id = next_group_id++;
+    group.attrs = attrs;
+    group.line_starts.reserve(GROUP_LINES);
+    group.line_starts.push_back(0);
+    bytes += sizeof(Group) + sizeof(uint32_t);
+    groups.push_back(std::move(group));
+}
+
+// The back group is about to change: forget its replayed lines.
+void LazyHistory::touch_back() {
+    uint64_t id = groups.back().id;
+    materialized.remove_if([&](const Materialized& m) { return m.id == id; });
+}
+
+// ------------------------------------------------------------
+// Eviction
+// ------------------------------------------------------------
+
+void LazyHistory::evict_front() {
+    row_index.pop_front();
+    --count;
+    if (++head == GROUP_LINES) {
+        uint64_t id = groups.front().id;
+        materialized.remove_if([&](const Materialized& m) { return m.id == id; });
+        bytes -= group_bytes(groups.front());
+        groups.pop_front();
+        head = 0;
+    }
+}
+
+void LazyHistory::enforce_limits() {
+    // Raw bytes are freed a whole group at a time; at least the newest
+    // finished line is always kept.
+    while (count > 1 &&
+           ((line_limit && count > line_limit) ||
+            (byte_limit && bytes + row_index.memory() > byte_limit)))
+        evict_front();
+}
+
+size_t LazyHistory::group_bytes(const Group& group) {
+    return sizeof(Group) + group.bytes.size() +
+           group.line_starts.size() * sizeof(uint32_t);
+}
+
+// ------------------------------------------------------------
+// Materialization
+// ------------------------------------------------------------
+
+LineView LazyHistory::operator[](size_t i) const {
+    size_t pos = head + i;
+    return materialize(groups[pos / GROUP_LINES])[pos % GROUP_LINES];
+}
+
+const ActiveLine& LazyHistory::active() const {
+    if (groups.empty())
+        return active_line;
+
+    // A new line (or group) started: read its tail from the beginning.
+    const Group& back = groups.back();
+    size_t start = back.line_starts.back();
+    if (active_group != back.id || active_start != start || active_fed > back.bytes.size()) {
+        active_parser.reset(tail_attrs);
+        active_line.clear();
+        active_group = back.id;
+        active_start = start;
+        active_fed   = start;
+    }
+
+    if (active_fed < back.bytes.size()) {
+        for (const auto& a : active_parser.parse_input(back.bytes.substr(active_fed))) {
+            if (a.type == ActionType::NEWLINE)
+                active_line.clear();
+            else
+                active_line.apply(a);
+        }
+        active_fed = back.bytes.size();
+    }
+    return active_line;
+}
+
+const LineBlock& LazyHistory::materialize(const Group& group) const {
+    for (auto it = materialized.begin(); it != materialized.end(); ++it) {
+        if (it->id == group.id) {
+            materialized.splice(materialized.begin(), materialized, it);
+            return materialized.front().lines;
+        }
+    }
+
+    LineBlock lines;
+    replay(group, lines);
+    // Keep the shape fixed even if the replay disagreed about a line count.
+    while (lines.size() < GROUP_LINES)
+        lines.push_back(ParsedLine{});
+
+    if (materialized.size() >= MATERIALIZED_CACHE_GROUPS)
+        materialized.pop_back();
+    materialized.push_front({group.id, std::move(lines)});
+    return materialized.front().lines;
+}
+
+// Finished lines of `group` into `lines`; the trailing partial line is
+// dropped (active() keeps that one).
+void LazyHistory::replay(const Group& group, LineBlock& lines) const {
+    replay_parser.reset(group.attrs);
+    ActiveLine line;
+
+    for (const auto& a : replay_parser.parse_input(group.bytes)) {
+        if (a.type == ActionType::NEWLINE) {
+            lines.push_back(line.line());
+            line.clear();
+        } else {
+            line.apply(a);
+        }
+    }
+}
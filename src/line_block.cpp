@@ -0,0 +1,351 @@
+#include "line_block.h"
+#include "grapheme.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+bool same_attributes(const TerminalAttributes& a, const TerminalAttributes& b) {
+    return a.foreground == b.foreground &&
+           a.background == b.background &&
+           a.bold == b.bold && a.italic == b.italic &&
+           a.underline == b.underline && a.blink == b.blink &&
+           a.reverse == b.reverse && a.strikethrough == b.strikethrough;
+}
+
+uint8_t pack_flags(const TerminalAttributes& a) {
+    return static_cast<uint8_t>(a.bold          << 0 |
+                                a.italic        << 1 |
+                                a.underline     << 2 |
+                                a.blink         << 3 |
+                                a.reverse       << 4 |
+                                a.strikethrough << 5);
+}
+
+uint64_t mix(uint64_t h, uint64_t word) {
+    h ^= word;
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t hash_color(uint64_t h, const TerminalColor& c) {
+    h = mix(h, static_cast<uint64_t>(c.type) << 40 |
+               static_cast<uint64_t>(c.ansi_color) << 32 |
+               static_cast<uint32_t>(c.indexed_color));
+    return mix(h, uint64_t{c.r} << 16 | uint64_t{c.g} << 8 | c.b);
+}
+
+uint64_t hash_attributes(const TerminalAttributes& a) {
+    uint64_t h = hash_color(0xCBF29CE484222325ull, a.foreground);
+    return mix(hash_color(h, a.background), pack_flags(a));
+}
+
+// ------------------------------------------------------------
+// Serialization helpers
+// ------------------------------------------------------------
+
+void put_varint(std::string& out, size_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void put_color(std::string& out, const TerminalColor& c) {
+    out.push_back(static_cast<char>(c.type));
+    out.push_back(static_cast<char>(c.ansi_color));
+    put_varint(out, static_cast<size_t>(c.indexed_color));
+    out.push_back(static_cast<char>(c.r));
+    out.push_back(static_cast<char>(c.g));
+    out.push_back(static_cast<char>(c.b));
+}
+
+void put_attributes(std::string& out, const TerminalAttributes& a) {
+    put_color(out, a.foreground);
+    put_color(out, a.background);
+    out.push_back(static_cast<char>(pack_flags(a)));
+}
+
+struct Reader {
+    const std::string& in;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint8_t byte() {
+        if (pos >= in.size()) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(in[pos++]);
+    }
+
+    size_t varint() {
+        size_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            v |= static_cast<size_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+        }
+        return v;
+    }
+
+    TerminalColor color() {
+        TerminalColor c;
+        c.type          = static_cast<TerminalColor::Type>(byte());
+        c.ansi_color    = static_cast<AnsiColor>(byte());
+        c.indexed_color = static_cast<int>(varint());
+        c.r = byte();
+        c.g = byte();
+        c.b = byte();
+        return c;
+    }
+
+    TerminalAttributes attributes() {
+        TerminalAttributes a;
+        a.foreground = color();
+        a.background = color();
+        uint8_t flags = byte();
+        a.bold          = flags & (1 << 0);
+        a.italic        = flags & (1 << 1);
+        a.underline     = flags & (1 << 2);
+        a.blink         = flags & (1 << 3);
+        a.reverse       = flags & (1 << 4);
+        a.strikethrough = flags & (1 << 5);
+        return a;
+    }
+};
+
+} // namespace
+
+// ------------------------------------------------------------
+// LineView
+// ------------------------------------------------------------
+
+SegmentView LineView::iterator::operator*() const {
+    uint32_t from = block->run_offset[run];
+    uint32_t to   = block->run_offset[run + 1];
+    return {std::string_view(block->text).substr(from, to - from),
+            block->attrs[block->run_attr[run]]};
+}
+
+LineView::LineView(const LineBlock* block, uint32_t line)
+    : block(block),
+      line(line),
+      first_run(block->line_run[line]),
+      last_run(block->line_run[line + 1])
+{
+}
+
+LineType LineView::type() const {
+    return block ? static_cast<LineType>(block->line_flags[line] & 0x7F)
+                 : LineType::UNKNOWN;
+}
+
+bool LineView::clear_screen() const {
+    return block && (block->line_flags[line] & 0x80);
+}
+
+LineView::iterator LineView::seek(size_t cell, size_t& run_cell) const {
+    run_cell = 0;
+    if (!block)
+        return begin();
+
+    const auto& longs = block->long_lines;
+    auto it = std::lower_bound(longs.begin(), longs.end(), line,
+                               [](const LineBlock::LongLine& l, uint32_t n) { return l.line < n; });
+    if (it == longs.end() || it->line != line)
+        return begin();
+
+    const uint32_t* cells = block->run_cells.data() + it->first;
+    size_t k = static_cast<size_t>(
+        std::upper_bound(cells, cells + segment_count(), cell) - cells);
+    if (k == 0)
+        return begin();
+    run_cell = cells[k - 1];
+    return {block, first_run + static_cast<uint32_t>(k - 1)};
+}
+
+// ------------------------------------------------------------
+// LineBlock
+// ------------------------------------------------------------
+
+LineBlock::LineBlock() {
+    clear();
+}
+
+void LineBlock::clear() {
+    text.clear();
+    run_offset.assign(1, 0);
+    run_attr.clear();
+    line_run.assign(1, 0);
+    line_flags.clear();
+    attrs.clear();
+    attr_ids.clear();
+    long_lines.clear();
+    run_cells.clear();
+}
+
+void LineBlock::push_back(const ParsedLine& line) {
+    size_t start = text.size();
+    for (const auto& seg : line.segments) {
+        if (seg.content.empty())
+            continue;
+        run_attr.push_back(intern(seg.attributes));
+        text += seg.content;
+        run_offset.push_back(static_cast<uint32_t>(text.size()));
+    }
+
+    line_run.push_back(static_cast<uint32_t>(run_attr.size()));
+    line_flags.push_back(static_cast<uint8_t>(static_cast<uint8_t>(line.type) |
+                                              (line.clear_screen ? 0x80 : 0)));
+
+    if (text.size() - start > LONG_LINE_BYTES)
+        index_long_line(static_cast<uint32_t>(size() - 1));
+}
+
+void LineBlock::index_long_line(uint32_t line) {
+    long_lines.push_back({line, static_cast<uint32_t>(run_cells.size())});
+
+    utl::GraphemeBreaker breaker;
+    size_t cells = 0;
+    for (uint32_t r = line_run[line]; r < line_run[line + 1]; ++r) {
+        run_cells.push_back(static_cast<uint32_t>(
+            std::min<size_t>(cells, std::numeric_limits<uint32_t>::max())));
+        std::string_view run(text.data() + run_offset[r], run_offset[r + 1] - run_offset[r]);
+        for (size_t i = 0; i < run.size();)
+            cells += utl::next_cell(breaker, run, i);
+    }
+}
+
+LineView LineBlock::operator[](size_t i) const {
+    if (i >= size())
+        return {};
+    return {this, static_cast<uint32_t>(i)};
+}
+
+size_t LineBlock::memory() const {
+    return sizeof(LineBlock) +
+           text.capacity() +
+           run_offset.capacity() * sizeof(uint32_t) +
+           run_attr.capacity() * sizeof(uint32_t) +
+           line_run.capacity() * sizeof(uint32_t) +
+           line_flags.capacity() +
+           attrs.capacity() * sizeof(TerminalAttributes) +
+           attr_ids.size() * 32 +   // node: key, id, cached hash, next
+           attr_ids.bucket_count() * sizeof(void*) +
+           long_lines.capacity() * sizeof(LongLine) +
+           run_cells.capacity() * sizeof(uint32_t);
+}
+
+// Attribute ids are per block. Runs of the same attributes usually sit next
+// to each other, so the newest few entries are checked first; anything
+// older is found by hash, keeping true-colour output (gradients, lolcat)
+// linear in the number of runs. Ids are 32-bit, so blocks with many
+// distinct attributes keep every one of them.
+uint32_t LineBlock::intern(const TerminalAttributes& a) {
+    size_t recent = attrs.size() > 8 ? attrs.size() - 8 : 0;
+    for (size_t i = attrs.size(); i-- > recent;)
+        if (same_attributes(attrs[i], a))
+            return static_cast<uint32_t>(i);
+
+    auto id = static_cast<uint32_t>(attrs.size());
+    auto [it, added] = attr_ids.try_emplace(hash_attributes(a), id);
+    if (!added) {
+        if (same_attributes(attrs[it->second], a))
+            return it->second;
+        // Two attribute sets with one hash: the older keeps the slot and
+        // this one is looked up the slow way
+        for (size_t i = recent; i-- > 0;)
+            if (same_attributes(attrs[i], a))
+                return static_cast<uint32_t>(i);
+    }
+
+    attrs.push_back(a);
+    return id;
+}
+
+// ------------------------------------------------------------
+// Serialization
+//
+//   varint attr_count, attr_count × attributes
+//   varint line_count, line_count × flags, line_count × varint run_count
+//   run_count × varint attr_id, run_count × varint length
+//   text
+//
+// Text and run metadata are kept apart so a compressor sees long stretches
+// of plain text instead of text interleaved with attribute bytes.
+// ------------------------------------------------------------
+
+std::string LineBlock::serialize() const {
+    std::string out;
+    out.reserve(text.size() + run_attr.size() * 3 + line_flags.size() * 2 + 64);
+
+    put_varint(out, attrs.size());
+    for (const auto& a : attrs)
+        put_attributes(out, a);
+
+    put_varint(out, size());
+    out.append(line_flags.begin(), line_flags.end());
+    for (size_t i = 0; i < size(); ++i)
+        put_varint(out, line_run[i + 1] - line_run[i]);
+
+    for (uint32_t id : run_attr)
+        put_varint(out, id);
+    for (size_t r = 0; r < run_attr.size(); ++r)
+        put_varint(out, run_offset[r + 1] - run_offset[r]);
+
+    out += text;
+    return out;
+}
+
+bool LineBlock::deserialize(const std::string& in, LineBlock& out) {
+    out.clear();
+    Reader r{in};
+
+    // Counts are checked against the input before anything is sized by them
+    size_t attr_count = r.varint();
+    if (!r.ok || attr_count > in.size())
+        return false;
+    out.attrs.resize(attr_count);
+    for (auto& a : out.attrs)
+        a = r.attributes();
+
+    size_t lines = r.varint();
+    if (!r.ok || lines > in.size())
+        return false;
+    out.line_flags.resize(lines);
+    for (auto& f : out.line_flags)
+        f = r.byte();
+
+    out.line_run.reserve(lines + 1);
+    for (size_t i = 0; i < lines; ++i)
+        out.line_run.push_back(out.line_run.back() + static_cast<uint32_t>(r.varint()));
+
+    size_t runs = out.line_run.back();
+    if (!r.ok || runs > in.size())
+        return false;
+    out.run_attr.resize(runs);
+    for (auto& id : out.run_attr) {
+        size_t attr = r.varint();
+        if (attr >= out.attrs.size())
+            return false;
+        id = static_cast<uint32_t>(attr);
+    }
+
+    out.run_offset.reserve(runs + 1);
+    for (size_t i = 0; i < runs; ++i)
+        out.run_offset.push_back(out.run_offset.back() + static_cast<uint32_t>(r.varint()));
+
+    if (!r.ok || in.size() - r.pos != out.run_offset.back())
+        return false;
+    out.text.assign(in, r.pos, std::string::npos);
+
+    for (size_t i = 0; i < lines; ++i)
+        if (out.run_offset[out.line_run[i + 1]] - out.run_offset[out.line_run[i]] >
+            LONG_LINE_BYTES)
+            out.index_long_line(static_cast<uint32_t>(i));
+    return true;
+}
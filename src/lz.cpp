@@ -0,0 +1,160 @@
+#include <cstring>
+
+#include "lz.h"
+
+namespace lz {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t HASH_LOG = 12;
+constexpr size_t MAX_OFFSET = 65535;
+// LZ4 keeps the tail of every block as literals so the decoder can copy
+// without bounds checks; we keep the same rule for format compatibility.
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MF_LIMIT = 12;
+
+uint32_t read32(const char *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hash(uint32_t seq) {
+  return (seq * 2654435761u) >> (32 - HASH_LOG);
+}
+
+void put_length(std::vector<uint8_t> &out, size_t len) {
+  while (len >= 255) {
+    out.push_back(255);
+    len -= 255;
+  }
+  out.push_back(static_cast<uint8_t>(len));
+}
+
+void emit_sequence(std::vector<uint8_t> &out, const char *literals,
+                   size_t lit_len, size_t offset, size_t match_len) {
+  size_t ml = match_len - MIN_MATCH;
+  uint8_t token = static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4);
+  token |= static_cast<uint8_t>(ml < 15 ? ml : 15);
+  out.push_back(token);
+
+  if (lit_len >= 15)
+    put_length(out, lit_len - 15);
+  out.insert(out.end(), literals, literals + lit_len);
+
+  out.push_back(static_cast<uint8_t>(offset & 0xFF));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (ml >= 15)
+    put_length(out, ml - 15);
+}
+
+void emit_last_literals(std::vector<uint8_t> &out, const char *literals,
+                        size_t lit_len) {
+  out.push_back(static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4));
+  if (lit_len >= 15)
+    put_length(out, lit_len - 15);
+  out.insert(out.end(), literals, literals + lit_len);
+}
+
+bool get_length(const uint8_t *&ip, const uint8_t *end, size_t &len) {
+  uint8_t b;
+  do {
+    if (ip >= end)
+      return false;
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+} // namespace
+
+std::vector<uint8_t> compress(std::string_view input) {
+  std::vector<uint8_t> out;
+  out.reserve(input.size() / 2 + 16);
+
+  const char *src = input.data();
+  size_t n = input.size();
+  size_t anchor = 0;
+
+  if (n > MF_LIMIT) {
+    // Positions are stored +1 so that 0 means "empty slot".
+    std::vector<uint32_t> table(size_t{1} << HASH_LOG, 0);
+    size_t limit = n - MF_LIMIT;
+    size_t ip = 0;
+
+    while (ip < limit) {
+      uint32_t seq = read32(src + ip);
+      uint32_t h = hash(seq);
+      size_t ref = table[h];
+      table[h] = static_cast<uint32_t>(ip + 1);
+
+      if (ref == 0 || ip - (ref - 1) > MAX_OFFSET ||
+          read32(src + ref - 1) != seq) {
+        ++ip;
+        continue;
+      }
+      --ref;
+
+      size_t match_len = MIN_MATCH;
+      while (ip + match_len < n - LAST_LITERALS &&
+             src[ref + match_len] == src[ip + match_len])
+        ++match_len;
+
+      emit_sequence(out, src + anchor, ip - anchor, ip - ref, match_len);
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+
+  emit_last_literals(out, src + anchor, n - anchor);
+  return out;
+}
+
+bool decompress(const uint8_t *src, size_t size, std::string &out,
+                size_t raw_size) {
+  out.clear();
+  out.reserve(raw_size);
+
+  const uint8_t *ip = src;
+  const uint8_t *end = src + size;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+
+    size_t lit_len = token >> 4;
+    if (lit_len == 15 && !get_length(ip, end, lit_len))
+      return false;
+    if (static_cast<size_t>(end - ip) < lit_len)
+      return false;
+    out.append(reinterpret_cast<const char *>(ip), lit_len);
+    ip += lit_len;
+
+    if (ip == end)
+      break; // last sequence: literals only
+
+    if (end - ip < 2)
+      return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > out.size())
+      return false;
+
+    size_t match_len = token & 0x0F;
+    if (match_len == 15 && !get_length(ip, end, match_len))
+      return false;
+    match_len += MIN_MATCH;
+    if (out.size() + match_len > raw_size)
+      return false;
+
+    // Matches may overlap their own output, so copy byte by byte.
+    size_t from = out.size() - offset;
+    for (size_t i = 0; i < match_len; ++i)
+      out.push_back(out[from + i]);
+  }
+
+  return out.size() == raw_size;
+}
+
+} // namespace lz
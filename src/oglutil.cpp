@@ -2,28 +2,16 @@
 
 namespace oglutil {
 
-void load_glyph_to_texture(FT_GlyphSlot glyph, unsigned int &texture) {
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, glyph->bitmap.width,
-               glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE,
-               glyph->bitmap.buffer);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-}
-
-void render_texture_over_rectangle(unsigned int &texture, unsigned int vbo,
-                                   float xpos, float ypos, float w, float h) {
+void render_texture_over_rectangle(unsigned int texture, unsigned int vbo,
+                                   float xpos, float ypos, float w, float h,
+                                   float u0, float v0, float u1, float v1) {
 
   float vertices[6][4] = {
-      {xpos, ypos + h, 0.0f, 0.0f},    {xpos, ypos, 0.0f, 1.0f},
-      {xpos + w, ypos, 1.0f, 1.0f},
+      {xpos, ypos + h, u0, v0},    {xpos, ypos, u0, v1},
+      {xpos + w, ypos, u1, v1},
 
-      {xpos, ypos + h, 0.0f, 0.0f},    {xpos + w, ypos, 1.0f, 1.0f},
-      {xpos + w, ypos + h, 1.0f, 0.0f}};
+      {xpos, ypos + h, u0, v0},    {xpos + w, ypos, u1, v1},
+      {xpos + w, ypos + h, u1, v0}};
 
   glBindTexture(GL_TEXTURE_2D, texture);
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -0,0 +1,46 @@
+#include "palette.h"
+
+namespace {
+
+// The ANSI colours as this terminal has always drawn them.
+constexpr Palette::Rgb ANSI[16] = {
+    {0, 0, 0},       {204, 0, 0},     {0, 204, 0},     {204, 204, 0},
+    {0, 0, 204},     {204, 0, 204},   {0, 204, 204},   {230, 230, 230},
+    {128, 128, 128}, {255, 0, 0},     {0, 255, 0},     {255, 255, 0},
+    {0, 0, 255},     {255, 0, 255},   {0, 255, 255},   {255, 255, 255},
+};
+
+// Intensities of the colour cube's six steps, as xterm has them.
+constexpr uint8_t CUBE[6] = {0, 95, 135, 175, 215, 255};
+
+} // namespace
+
+Palette::Palette() {
+  for (int slot = 0; slot < SIZE; ++slot)
+    colors[slot] = default_color(slot);
+}
+
+Palette::Rgb Palette::default_color(int slot) {
+  if (slot < 16)
+    return ANSI[slot];
+  if (slot < 232) {
+    int i = slot - 16;
+    return {CUBE[i / 36], CUBE[i / 6 % 6], CUBE[i % 6]};
+  }
+  if (slot < COLORS) {
+    auto grey = static_cast<uint8_t>(8 + (slot - 232) * 10);
+    return {grey, grey, grey};
+  }
+  return slot == FOREGROUND ? Rgb{255, 255, 255} : Rgb{0, 0, 0};
+}
+
+void Palette::set(int slot, Rgb rgb) {
+  if (slot < 0 || slot >= SIZE)
+    return;
+  colors[slot] = rgb;
+  ++changes;
+}
+
+void Palette::reset(int slot) {
+  set(slot, default_color(slot));
+}
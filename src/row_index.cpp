@@ -0,0 +1,328 @@
+#include "row_index.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace {
+
+constexpr size_t COMPACT_MIN_DEAD = 4096;
+
+size_t lowbit(size_t i) {
+    return i & (~i + 1);
+}
+
+// Lays cells out in rows of `cols` the way the renderer wraps them,
+// noting where row `target` starts.
+struct Layout {
+    size_t cols;
+    size_t target;
+    size_t rows  = 1;          // rows started
+    size_t used  = 0;          // cells in the last of them
+    size_t cell  = 0;          // cells laid out
+    size_t found = SIZE_MAX;   // cell where row `target` starts
+
+    void new_row() {
+        if (rows == target)
+            found = cell;
+        ++rows;
+        used = 0;
+    }
+
+    // `more` further rows of `stride` cells each start from `cell`.
+    void note_rows(size_t more, size_t stride) {
+        if (target >= rows && target - rows < more)
+            found = cell + (target - rows) * stride;
+        rows += more;
+    }
+
+    // Narrow cells fill every row to the last column.
+    void narrow(size_t n) {
+        if (n == 0)
+            return;
+        if (used >= cols)
+            new_row();
+        size_t fit = std::min(n, cols - used);
+        used += fit;
+        cell += fit;
+        n -= fit;
+        if (n == 0)
+            return;
+
+        size_t full = (n - 1) / cols;
+        note_rows(full + 1, cols);
+        cell += n;
+        used = n - full * cols;
+    }
+
+    // A double-width cluster never straddles the last column; with one
+    // column each takes a row of its own.
+    void wide(size_t n) {
+        if (n == 0)
+            return;
+        if (used > 0 && used + 2 > cols)
+            new_row();
+        size_t per = std::max<size_t>(cols / 2, 1);
+        size_t fit = std::min(n, used == 0 ? per : (cols - used) / 2);
+        used += 2 * fit;
+        cell += 2 * fit;
+        n -= fit;
+        if (n == 0)
+            return;
+
+        size_t full = (n - 1) / per;
+        note_rows(full + 1, 2 * per);
+        cell += 2 * n;
+        used = 2 * (n - full * per);
+    }
+};
+
+} // namespace
+
+void RowIndex::LineCells::add(std::string_view text) {
+    for (size_t i = 0; i < text.size();) {
+        size_t w = utl::next_cell(breaker, text, i);
+        if (w == 2 && breaker.at_boundary() &&
+            total <= std::numeric_limits<uint32_t>::max()) {
+            if (!runs.empty() && runs.back().cell + 2 * size_t{runs.back().count} == total)
+                ++runs.back().count;
+            else
+                runs.push_back({static_cast<uint32_t>(total), 1});
+        }
+        total += w;
+    }
+}
+
+size_t RowIndex::layout(size_t cells, std::span<const WideRun> wide, size_t cols,
+                        size_t row, size_t* start) {
+    Layout lay{std::max<size_t>(cols, 1), row};
+    size_t at = 0;
+    for (const WideRun& run : wide) {
+        lay.narrow(run.cell - at);
+        lay.wide(run.count);
+        at = run.cell + 2 * size_t{run.count};
+    }
+    lay.narrow(cells - at);
+
+    if (start)
+        *start = row == 0 ? 0 : std::min(lay.found, cells);
+    return lay.rows;
+}
+
+void RowIndex::push_back(size_t cells_in_line, std::span<const WideRun> wide) {
+    uint32_t cells = static_cast<uint32_t>(
+        std::min<size_t>(cells_in_line, std::numeric_limits<uint32_t>::max()));
+
+    // Drop runs that do not fit the line, so layout() can trust them.
+    size_t at = 0;
+    size_t kept = 0;
+    for (const WideRun& run : wide) {
+        if (run.cell < at || run.cell + 2 * size_t{run.count} > cells)
+            break;
+        at = run.cell + 2 * size_t{run.count};
+        ++kept;
+    }
+    if (kept) {
+        slots.wide_lines.push_back({slots.cells.size(),
+                                    static_cast<uint32_t>(slots.runs.size())});
+        slots.runs.insert(slots.runs.end(), wide.begin(), wide.begin() + kept);
+    }
+    slots.cells.push_back(cells);
+
+    if (tree_cols)
+        append_node();
+}
+
+size_t RowIndex::row_start(size_t line, size_t cols, size_t row) const {
+    size_t start = 0;
+    size_t slot = first + line;
+    layout(slots.cells[slot], slots.wide(slot), cols, row, &start);
+    return start;
+}
+
+size_t RowIndex::memory() const {
+    auto live = std::lower_bound(slots.wide_lines.begin(), slots.wide_lines.end(), first,
+                                 [](const Slots::Wide& w, size_t s) { return w.slot < s; });
+    size_t wide_lines = static_cast<size_t>(slots.wide_lines.end() - live);
+    size_t runs = live == slots.wide_lines.end() ? 0 : slots.runs.size() - live->begin;
+    return size() * (sizeof(uint32_t) + sizeof(uint64_t)) +
+           wide_lines * sizeof(Slots::Wide) + runs * sizeof(WideRun);
+}
+
+std::span<const RowIndex::WideRun> RowIndex::Slots::wide(size_t slot) const {
+    auto it = std::lower_bound(wide_lines.begin(), wide_lines.end(), slot,
+                               [](const Wide& w, size_t s) { return w.slot < s; });
+    if (it == wide_lines.end() || it->slot != slot)
+        return {};
+    size_t end = it + 1 == wide_lines.end() ? runs.size() : (it + 1)->begin;
+    return {runs.data() + it->begin, end - it->begin};
+}
+
+size_t RowIndex::Slots::rows(size_t slot, size_t cols) const {
+    if (wide_lines.empty() || wide_lines.back().slot < slot ||
+        wide_lines.front().slot > slot)
+        return rows_for(cells[slot], cols);
+    std::span<const WideRun> w = wide(slot);
+    return w.empty() ? rows_for(cells[slot], cols) : layout(cells[slot], w, cols);
+}
+
+// Removes the first `n` slots and renumbers the rest.
+void RowIndex::Slots::drop_front(size_t n) {
+    cells.erase(cells.begin(), cells.begin() + static_cast<std::ptrdiff_t>(n));
+
+    auto keep = std::lower_bound(wide_lines.begin(), wide_lines.end(), n,
+                                 [](const Wide& w, size_t s) { return w.slot < s; });
+    uint32_t dropped = keep == wide_lines.end()
+        ? static_cast<uint32_t>(runs.size()) : keep->begin;
+    wide_lines.erase(wide_lines.begin(), keep);
+    runs.erase(runs.begin(), runs.begin() + dropped);
+    for (Wide& w : wide_lines) {
+        w.slot  -= n;
+        w.begin -= dropped;
+    }
+}
+
+// Fenwick append for slot slots.cells.size() - 1: node i covers (i - lowbit(i), i].
+void RowIndex::append_node() const {
+    size_t i = tree.size() + 1;
+    tree.push_back(slots.rows(i - 1, tree_cols) +
+                   prefix(i - 1) - prefix(i - lowbit(i)));
+}
+
+void RowIndex::pop_front() {
+    if (empty())
+        return;
+
+    if (tree_cols) {
+        uint64_t rows = slots.rows(first, tree_cols);
+        for (size_t i = first + 1; i <= tree.size(); i += lowbit(i))
+            tree[i - 1] -= rows;
+    }
+    ++first;
+
+    if (first >= COMPACT_MIN_DEAD && first * 2 >= slots.cells.size()) {
+        slots.drop_front(first);
+        first = 0;
+        tree_cols = 0;
+        ++generation;
+    }
+}
+
+void RowIndex::clear() {
+    slots = Slots{};
+    first = 0;
+    tree.clear();
+    tree_cols = 0;
+    ++generation;
+}
+
+bool RowIndex::ready(size_t cols) const {
+    cols = std::max<size_t>(cols, 1);
+    if (tree_cols == cols)
+        return true;
+
+    if (job) {
+        if (!job->done.load(std::memory_order_acquire))
+            return false;
+        std::shared_ptr<Job> finished = std::move(job);
+        if (finished->cols == cols && finished->generation == generation) {
+            adopt(*finished);
+            return true;
+        }
+    }
+
+    if (size() < BACKGROUND_MIN_LINES) {
+        build(cols);
+        return true;
+    }
+
+    auto next = std::make_shared<Job>();
+    next->cols = cols;
+    next->generation = generation;
+    next->first = first;
+    next->size = slots.cells.size();
+
+    std::thread([next, snapshot = slots] {
+        next->tree = make_tree(snapshot, next->first, next->cols);
+        next->done.store(true, std::memory_order_release);
+    }).detach();
+
+    job = std::move(next);
+    return false;
+}
+
+size_t RowIndex::total(size_t cols) const {
+    build(cols);
+    return prefix(slots.cells.size());
+}
+
+size_t RowIndex::rows_before(size_t cols, size_t line) const {
+    build(cols);
+    return prefix(std::min(first + line, slots.cells.size()));
+}
+
+std::pair<size_t, size_t> RowIndex::locate(size_t cols, size_t row) const {
+    build(cols);
+
+    // Binary lifting: the largest slot count whose rows still fit in `row`.
+    size_t pos = 0;
+    uint64_t rest = row;
+    size_t step = 1;
+    while (step * 2 <= tree.size())
+        step *= 2;
+    for (; step; step /= 2) {
+        if (pos + step <= tree.size() && tree[pos + step - 1] <= rest) {
+            pos += step;
+            rest -= tree[pos - 1];
+        }
+    }
+
+    if (pos >= slots.cells.size())
+        return {size(), 0};
+    return {pos - first, static_cast<size_t>(rest)};
+}
+
+void RowIndex::build(size_t cols) const {
+    cols = std::max<size_t>(cols, 1);
+    if (tree_cols == cols)
+        return;
+
+    tree = make_tree(slots, first, cols);
+    tree_cols = cols;
+}
+
+// Takes over a tree built from an older snapshot and replays what changed
+// since: evictions zero their slots, appends extend the tree.
+void RowIndex::adopt(Job& done) const {
+    tree = std::move(done.tree);
+    tree_cols = done.cols;
+
+    for (size_t slot = done.first; slot < first; ++slot) {
+        uint64_t rows = slots.rows(slot, tree_cols);
+        for (size_t i = slot + 1; i <= tree.size(); i += lowbit(i))
+            tree[i - 1] -= rows;
+    }
+    while (tree.size() < slots.cells.size())
+        append_node();
+}
+
+// O(n) construction: every node pushes its sum to its parent.
+std::vector<uint64_t> RowIndex::make_tree(const Slots& slots, size_t first,
+                                          size_t cols) {
+    std::vector<uint64_t> tree(slots.cells.size(), 0);
+    for (size_t i = first; i < slots.cells.size(); ++i)
+        tree[i] = slots.rows(i, cols);
+    for (size_t i = 1; i <= tree.size(); ++i) {
+        size_t parent = i + lowbit(i);
+        if (parent <= tree.size())
+            tree[parent - 1] += tree[i - 1];
+    }
+    return tree;
+}
+
+uint64_t RowIndex::prefix(size_t n) const {
+    uint64_t sum = 0;
+    for (; n > 0; n -= lowbit(n))
+        sum += tree[n - 1];
+    return sum;
+}
@@ -0,0 +1,239 @@
+#include "script_runs.h"
+#include "unicode_table.h"
+#include "utf8_decoder.h"
+#include "utils.h"
+
+#include <array>
+#include <iterator>
+
+namespace utl {
+namespace {
+
+using ucd::Range;
+
+constexpr Range latin[] = {
+    {0x0041, 0x005A},   {0x0061, 0x007A},   {0x00AA, 0x00AA},   {0x00BA, 0x00BA},
+    {0x00C0, 0x00D6},   {0x00D8, 0x00F6},   {0x00F8, 0x02B8},   {0x02E0, 0x02E4},
+    {0x1D00, 0x1D25},   {0x1D2C, 0x1D5C},   {0x1D62, 0x1D65},   {0x1D6B, 0x1D77},
+    {0x1D79, 0x1DBE},   {0x1E00, 0x1EFF},   {0x2071, 0x2071},   {0x207F, 0x207F},
+    {0x2090, 0x209C},   {0x212A, 0x212B},   {0x2132, 0x2132},   {0x214E, 0x214E},
+    {0x2160, 0x2188},   {0x2C60, 0x2C7F},   {0xA722, 0xA787},   {0xA78B, 0xA7CA},
+    {0xA7F2, 0xA7FF},   {0xAB30, 0xAB5A},   {0xAB5C, 0xAB64},   {0xFB00, 0xFB06},
+    {0xFF21, 0xFF3A},   {0xFF41, 0xFF5A},
+};
+constexpr Range greek[] = {
+    {0x0370, 0x0373},   {0x0375, 0x0377},   {0x037A, 0x037D},   {0x037F, 0x037F},
+    {0x0384, 0x0384},   {0x0386, 0x0386},   {0x0388, 0x038A},   {0x038C, 0x038C},
+    {0x038E, 0x03A1},   {0x03A3, 0x03E1},   {0x03F0, 0x03FF},   {0x1D26, 0x1D2A},
+    {0x1D5D, 0x1D61},   {0x1D66, 0x1D6A},   {0x1DBF, 0x1DBF},   {0x1F00, 0x1FFE},
+    {0x2126, 0x2126},   {0xAB65, 0xAB65},   {0x10140, 0x1018E},
+};
+constexpr Range cyrillic[] = {
+    {0x0400, 0x0484},   {0x0487, 0x052F},   {0x1C80, 0x1C88},   {0x1D2B, 0x1D2B},
+    {0x1D78, 0x1D78},   {0x2DE0, 0x2DFF},   {0xA640, 0xA69F},
+};
+constexpr Range armenian[] = {
+    {0x0531, 0x0556},   {0x0559, 0x058A},   {0x058D, 0x058F},   {0xFB13, 0xFB17},
+};
+constexpr Range hebrew[] = {
+    {0x0591, 0x05C7},   {0x05D0, 0x05EA},   {0x05EF, 0x05F4},   {0xFB1D, 0xFB4F},
+};
+constexpr Range arabic[] = {
+    {0x0600, 0x06FF},   {0x0750, 0x077F},   {0x0870, 0x08FF},   {0xFB50, 0xFDFF},
+    {0xFE70, 0xFEFC},   {0x1EE00, 0x1EEFF},
+};
+constexpr Range syriac[] = {{0x0700, 0x074F}, {0x0860, 0x086A}};
+constexpr Range thaana[] = {{0x0780, 0x07B1}};
+constexpr Range nko[] = {{0x07C0, 0x07FF}};
+constexpr Range devanagari[] = {{0x0900, 0x097F}, {0xA8E0, 0xA8FF}};
+constexpr Range bengali[] = {{0x0980, 0x09FE}};
+constexpr Range gurmukhi[] = {{0x0A01, 0x0A76}};
+constexpr Range gujarati[] = {{0x0A81, 0x0AFF}};
+constexpr Range oriya[] = {{0x0B01, 0x0B77}};
+constexpr Range tamil[] = {{0x0B82, 0x0BFA}, {0x11FC0, 0x11FFF}};
+constexpr Range telugu[] = {{0x0C00, 0x0C7F}};
+constexpr Range kannada[] = {{0x0C80, 0x0CF3}};
+constexpr Range malayalam[] = {{0x0D00, 0x0D7F}};
+constexpr Range sinhala[] = {{0x0D81, 0x0DF4}, {0x111E1, 0x111F4}};
+constexpr Range thai[] = {{0x0E01, 0x0E5B}};
+constexpr Range lao[] = {{0x0E81, 0x0EDF}};
+constexpr Range tibetan[] = {{0x0F00, 0x0FDA}};
+constexpr Range myanmar[] = {{0x1000, 0x109F}, {0xA9E0, 0xA9FE}, {0xAA60, 0xAA7F}};
+constexpr Range georgian[] = {{0x10A0, 0x10FF}, {0x1C90, 0x1CBF}, {0x2D00, 0x2D2D}};
+constexpr Range hangul[] = {
+    {0x1100, 0x11FF},   {0x3131, 0x318E},   {0x3200, 0x321E},   {0x3260, 0x327E},
+    {0xA960, 0xA97C},   {0xAC00, 0xD7A3},   {0xD7B0, 0xD7FB},   {0xFFA0, 0xFFDC},
+};
+constexpr Range ethiopic[] = {{0x1200, 0x139F}, {0x2D80, 0x2DDE}, {0xAB01, 0xAB2E}};
+constexpr Range khmer[] = {{0x1780, 0x17FF}, {0x19E0, 0x19FF}};
+constexpr Range mongolian[] = {{0x1800, 0x18AA}};
+constexpr Range hiragana[] = {
+    {0x3041, 0x3096},   {0x309D, 0x309F},   {0x1B001, 0x1B11F}, {0x1F200, 0x1F200},
+};
+constexpr Range katakana[] = {
+    {0x30A1, 0x30FA},   {0x30FD, 0x30FF},   {0x31F0, 0x31FF},   {0x32D0, 0x32FE},
+    {0x3300, 0x3357},   {0xFF66, 0xFF6F},   {0xFF71, 0xFF9D},   {0x1B000, 0x1B000},
+};
+constexpr Range han[] = {
+    {0x2E80, 0x2FD5},   {0x3005, 0x3005},   {0x3007, 0x3007},   {0x3021, 0x3029},
+    {0x3038, 0x303B},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},   {0xF900, 0xFAD9},
+    {0x20000, 0x323AF},
+};
+
+// Characters inside the blocks above that several scripts share.
+constexpr Range common[] = {
+    {0x0589, 0x0589},   {0x0605, 0x0605},   {0x060C, 0x060C},   {0x061B, 0x061B},
+    {0x061F, 0x061F},   {0x0640, 0x0640},   {0x06DD, 0x06DD},   {0x08E2, 0x08E2},
+    {0x0964, 0x0965},   {0x0E3F, 0x0E3F},   {0x0FD5, 0x0FD8},   {0x10FB, 0x10FB},
+    {0x1802, 0x1803},   {0x1805, 0x1805},   {0x3006, 0x3006},   {0x309B, 0x309C},
+    {0x30A0, 0x30A0},   {0x30FB, 0x30FC},   {0xFF70, 0xFF70},   {0xFF9E, 0xFF9F},
+};
+
+constexpr Range inherited[] = {
+    {0x0300, 0x036F},   {0x0485, 0x0486},   {0x064B, 0x0655},   {0x0670, 0x0670},
+    {0x0951, 0x0954},   {0x1AB0, 0x1ACE},   {0x1CD0, 0x1CD2},   {0x1CD4, 0x1CE0},
+    {0x1CE2, 0x1CE8},   {0x1CED, 0x1CED},   {0x1CF4, 0x1CF4},   {0x1CF8, 0x1CF9},
+    {0x1DC0, 0x1DFF},   {0x200C, 0x200D},   {0x20D0, 0x20F0},   {0x302A, 0x302D},
+    {0x3099, 0x309A},   {0xFE00, 0xFE0F},   {0xFE20, 0xFE2D},   {0x101FD, 0x101FD},
+    {0xE0100, 0xE01EF},
+};
+
+static_assert(ucd::sorted(latin) && ucd::sorted(greek) && ucd::sorted(cyrillic) &&
+              ucd::sorted(arabic) && ucd::sorted(hangul) && ucd::sorted(hiragana) &&
+              ucd::sorted(katakana) && ucd::sorted(han) && ucd::sorted(common) &&
+              ucd::sorted(inherited));
+
+template <size_t N> constexpr ucd::Layer script(const Range (&ranges)[N], Script s) {
+  return ucd::layer(ranges, static_cast<uint8_t>(s));
+}
+
+constexpr ucd::Builder built = ucd::build(
+    std::array{
+        script(latin, Script::Latin),           script(greek, Script::Greek),
+        script(cyrillic, Script::Cyrillic),     script(armenian, Script::Armenian),
+        script(hebrew, Script::Hebrew),         script(arabic, Script::Arabic),
+        script(syriac, Script::Syriac),         script(thaana, Script::Thaana),
+        script(nko, Script::Nko),               script(devanagari, Script::Devanagari),
+        script(bengali, Script::Bengali),       script(gurmukhi, Script::Gurmukhi),
+        script(gujarati, Script::Gujarati),     script(oriya, Script::Oriya),
+        script(tamil, Script::Tamil),           script(telugu, Script::Telugu),
+        script(kannada, Script::Kannada),       script(malayalam, Script::Malayalam),
+        script(sinhala, Script::Sinhala),       script(thai, Script::Thai),
+        script(lao, Script::Lao),               script(tibetan, Script::Tibetan),
+        script(myanmar, Script::Myanmar),       script(georgian, Script::Georgian),
+        script(hangul, Script::Hangul),         script(ethiopic, Script::Ethiopic),
+        script(khmer, Script::Khmer),           script(mongolian, Script::Mongolian),
+        script(hiragana, Script::Hiragana),     script(katakana, Script::Katakana),
+        script(han, Script::Han),
+        script(common, Script::Common),         script(inherited, Script::Inherited),
+    },
+    static_cast<uint8_t>(Script::Common));
+constexpr auto table = ucd::trim<built>();
+
+constexpr const char *tags[] = {
+    "Zyyy", "Zinh", "Latn", "Grek", "Cyrl", "Armn", "Hebr", "Arab", "Syrc",
+    "Thaa", "Nkoo", "Deva", "Beng", "Guru", "Gujr", "Orya", "Taml", "Telu",
+    "Knda", "Mlym", "Sinh", "Thai", "Laoo", "Tibt", "Mymr", "Geor", "Hang",
+    "Ethi", "Khmr", "Mong", "Hira", "Kana", "Hani",
+};
+static_assert(std::size(tags) == static_cast<size_t>(Script::Han) + 1);
+
+Script ascii_script(unsigned char c) {
+  return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') ? Script::Latin : Script::Common;
+}
+
+} // namespace
+
+Script script_of(char32_t cp) {
+  if (cp < 0x80)
+    return ascii_script(static_cast<unsigned char>(cp));
+  return static_cast<Script>(table[cp]);
+}
+
+const char *script_tag(Script script) {
+  return tags[static_cast<size_t>(script)];
+}
+
+bool needs_shaping(Script script) {
+  switch (script) {
+    case Script::Arabic:
+    case Script::Syriac:
+    case Script::Thaana:
+    case Script::Nko:
+    case Script::Devanagari:
+    case Script::Bengali:
+    case Script::Gurmukhi:
+    case Script::Gujarati:
+    case Script::Oriya:
+    case Script::Tamil:
+    case Script::Telugu:
+    case Script::Kannada:
+    case Script::Malayalam:
+    case Script::Sinhala:
+    case Script::Tibetan:
+    case Script::Myanmar:
+    case Script::Khmer:
+    case Script::Mongolian:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void itemize(std::string_view text, std::vector<ScriptRun> &runs) {
+  runs.clear();
+  Script current = Script::Common;
+  size_t start = 0;
+
+  for (size_t i = 0; i < text.size();) {
+    size_t at = i;
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    Script s;
+    if (c < 0x80) {
+      s = ascii_script(c);
+      ++i;
+    } else {
+      s = script_of(get_next_codepoint(text, i));
+    }
+
+    if (s == Script::Common || s == Script::Inherited)
+      continue;
+    if (current == Script::Common) {
+      current = s;   // leading neutrals join the first script
+    } else if (s != current) {
+      runs.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(at), current});
+      start = at;
+      current = s;
+    }
+  }
+
+  if (start < text.size())
+    runs.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(text.size()), current});
+}
+
+// The returned runs stay valid until the next call.
+const std::vector<ScriptRun> &ScriptRunCache::runs(std::string_view text) {
+  if (ascii_prefix(text.data(), text.size()) == text.size()) {
+    ascii.clear();
+    if (!text.empty())
+      ascii.push_back({0, static_cast<uint32_t>(text.size()), Script::Latin});
+    return ascii;
+  }
+
+  auto it = entries.find(text);
+  if (it == entries.end()) {
+    it = entries.emplace(std::string(text), Entry{}).first;
+    itemize(text, it->second.runs);
+  }
+  it->second.used = frame;
+  return it->second.runs;
+}
+
+void ScriptRunCache::next_frame() {
+  ++frame;
+  if (frame % KEEP_FRAMES != 0)
+    return;
+  std::erase_if(entries, [this](const auto &e) { return frame - e.second.used > KEEP_FRAMES; });
+}
+
+} // namespace utl
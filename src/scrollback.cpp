@@ -0,0 +1,186 @@
+#include "scrollback.h"
+#include "lz.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+Scrollback::Scrollback(size_t max_lines, size_t max_bytes)
+    : line_limit(max_lines),
+      byte_limit(max_bytes)
+{
+}
+
+void Scrollback::set_limits(size_t max_lines, size_t max_bytes) {
+    line_limit = max_lines;
+    byte_limit = max_bytes;
+    enforce_limits();
+}
+
+void Scrollback::set_cold_after(size_t blocks) {
+    cold_after = blocks;
+    seal_cold_blocks();
+    enforce_limits();
+}
+
+bool Scrollback::enable_disk_backing(const std::string& dir, bool keep) {
+    if (file.is_open())
+        return true;
+    if (!file.open(dir, keep))
+        return false;
+
+    for (auto& block : blocks)
+        if (block.cold)
+            spill(block);
+    return true;
+}
+
+void Scrollback::push_back(const ParsedLine& line) {
+    if (blocks.empty() || blocks.back().lines.size() == BLOCK_LINES) {
+        blocks.emplace_back();
+        blocks.back().id = next_block_id++;
+        seal_cold_blocks();
+    }
+
+    RowIndex::LineCells cells;
+    for (const auto& seg : line.segments)
+        cells.add(seg.content);
+    row_index.push_back(cells);
+
+    Block& back = blocks.back();
+    bytes -= back.bytes;
+    back.lines.push_back(line);
+    back.bytes = back.lines.memory();
+    bytes += back.bytes;
+    ++count;
+
+    enforce_limits();
+}
+
+void Scrollback::clear() {
+    blocks.clear();
+    decoded.clear();
+    row_index.clear();
+    file.reset();
+    head  = 0;
+    count = 0;
+    bytes = 0;
+}
+
+LineView Scrollback::operator[](size_t i) const {
+    size_t pos = head + i;
+    const Block& block = blocks[pos / BLOCK_LINES];
+    if (block.cold)
+        return decode(block)[pos % BLOCK_LINES];
+    return block.lines[pos % BLOCK_LINES];
+}
+
+ScrollbackUsage Scrollback::usage() const {
+    size_t cold = std::count_if(blocks.begin(), blocks.end(),
+                                [](const Block& b) { return b.cold; });
+    return {count, resident(), cold, static_cast<size_t>(file.size())};
+}
+
+// ------------------------------------------------------------
+// Eviction
+// ------------------------------------------------------------
+
+void Scrollback::evict_front() {
+    Block& front = blocks.front();
+    row_index.pop_front();
+    --count;
+
+    if (++head == BLOCK_LINES || count == 0) {
+        bytes -= front.bytes;
+        decoded.remove_if([&](const Decoded& d) { return d.id == front.id; });
+        if (front.spilled)
+            file.discard(front.file_offset, front.packed_size);
+        blocks.pop_front();
+        head = 0;
+    }
+}
+
+void Scrollback::enforce_limits() {
+    // The newest line is always kept, even if it alone exceeds the byte cap.
+    while (count > 1 &&
+           ((line_limit && count > line_limit) ||
+            (byte_limit && resident() > byte_limit)))
+        evict_front();
+}
+
+// ------------------------------------------------------------
+// Cold blocks
+// ------------------------------------------------------------
+
+void Scrollback::seal_cold_blocks() {
+    if (cold_after == 0 || blocks.size() <= cold_after)
+        return;
+
+    // Everything before the newest `cold_after` blocks is full; walk back
+    // from the threshold until we meet an already sealed block.
+    for (size_t i = blocks.size() - cold_after; i-- > 0;) {
+        if (blocks[i].cold)
+            break;
+        seal(blocks[i]);
+    }
+}
+
+void Scrollback::seal(Block& block) {
+    std::string raw = block.lines.serialize();
+
+    block.packed = lz::compress(raw);
+    block.packed.shrink_to_fit();
+    block.packed_size = block.packed.size();
+    block.raw_size = raw.size();
+    block.lines = LineBlock{};
+    block.cold = true;
+
+    bytes -= block.bytes;
+    block.bytes = sizeof(Block) + block.packed.capacity();
+    bytes += block.bytes;
+
+    if (file.is_open())
+        spill(block);
+}
+
+void Scrollback::spill(Block& block) {
+    uint64_t offset = file.append(block.packed.data(), block.packed.size());
+    if (offset == UINT64_MAX)
+        return; // keep it in RAM
+
+    block.file_offset = offset;
+    block.spilled = true;
+    block.packed.clear();
+    block.packed.shrink_to_fit();
+
+    bytes -= block.bytes;
+    block.bytes = sizeof(Block);
+    bytes += block.bytes;
+}
+
+const LineBlock& Scrollback::decode(const Block& block) const {
+    for (auto it = decoded.begin(); it != decoded.end(); ++it) {
+        if (it->id == block.id) {
+            decoded.splice(decoded.begin(), decoded, it);
+            return decoded.front().lines;
+        }
+    }
+
+    const uint8_t* packed = block.spilled
+        ? file.data(block.file_offset, block.packed_size)
+        : block.packed.data();
+
+    std::string raw;
+    LineBlock lines;
+    if (!packed || !lz::decompress(packed, block.packed_size, raw, block.raw_size) ||
+        !LineBlock::deserialize(raw, lines))
+        lines.clear();
+    // Keep the shape fixed so indexing a damaged block stays in range.
+    while (lines.size() < BLOCK_LINES)
+        lines.push_back(ParsedLine{});
+
+    if (decoded.size() >= DECODED_CACHE_BLOCKS)
+        decoded.pop_back();
+    decoded.push_front({block.id, std::move(lines)});
+    return decoded.front().lines;
+}
@@ -0,0 +1,138 @@
+#include "scrollback_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <print>
+#include <vector>
+
+namespace {
+
+// Mappings grow in large steps so remapping stays rare.
+constexpr size_t MAP_STEP = 64u << 20;
+
+} // namespace
+
+ScrollbackFile::~ScrollbackFile() {
+    close();
+}
+
+bool ScrollbackFile::open(const std::string& dir, bool keep) {
+    close();
+
+    std::string base = dir;
+    if (base.empty()) {
+        const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+        base = runtime ? runtime : "/tmp";
+    }
+
+    std::string tmpl = base + "/sita-scrollback-" + std::to_string(getpid()) + "-XXXXXX";
+    std::vector<char> name(tmpl.begin(), tmpl.end());
+    name.push_back('\0');
+
+    fd = mkstemp(name.data());
+    if (fd < 0) {
+        std::println(std::cerr, "ERROR::SCROLLBACK: Could not create {}: {}",
+                     tmpl, std::strerror(errno));
+        return false;
+    }
+
+    path = name.data();
+    if (!keep) {
+        unlink(path.c_str());
+        path.clear();
+    } else {
+        std::println(std::cerr, "Scrollback is kept in {}", path);
+    }
+    file_size = 0;
+    return true;
+}
+
+void ScrollbackFile::close() {
+    if (map)
+        munmap(map, map_size);
+    map = nullptr;
+    map_size = 0;
+
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    file_size = 0;
+}
+
+uint64_t ScrollbackFile::append(const uint8_t* data, size_t size) {
+    if (fd < 0)
+        return UINT64_MAX;
+
+    uint64_t offset = file_size;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, data + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            std::println(std::cerr, "ERROR::SCROLLBACK: Write failed: {}",
+                         std::strerror(errno));
+            return UINT64_MAX;
+        }
+        done += static_cast<size_t>(n);
+    }
+
+    file_size += size;
+    return offset;
+}
+
+const uint8_t* ScrollbackFile::data(uint64_t offset, size_t size) {
+    if (fd < 0 || offset + size > file_size || !ensure_mapped(offset + size))
+        return nullptr;
+    return map + offset;
+}
+
+void ScrollbackFile::discard(uint64_t offset, size_t size) {
+    if (fd < 0 || size == 0)
+        return;
+    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              static_cast<off_t>(offset), static_cast<off_t>(size));
+}
+
+void ScrollbackFile::reset() {
+    if (fd < 0)
+        return;
+    if (map)
+        munmap(map, map_size);
+    map = nullptr;
+    map_size = 0;
+
+    if (ftruncate(fd, 0) != 0)
+        std::println(std::cerr, "ERROR::SCROLLBACK: Truncate failed: {}",
+                     std::strerror(errno));
+    file_size = 0;
+}
+
+bool ScrollbackFile::ensure_mapped(uint64_t end) {
+    if (map && end <= map_size)
+        return true;
+
+    // Map past EOF in whole steps; only pages below file_size are touched.
+    size_t want = ((end + MAP_STEP - 1) / MAP_STEP) * MAP_STEP;
+    void* p = map ? mremap(map, map_size, want, MREMAP_MAYMOVE)
+                  : mmap(nullptr, want, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        std::println(std::cerr, "ERROR::SCROLLBACK: mmap failed: {}",
+                     std::strerror(errno));
+        if (map)
+            munmap(map, map_size);
+        map = nullptr;
+        map_size = 0;
+        return false;
+    }
+
+    map = static_cast<uint8_t*>(p);
+    map_size = want;
+    return true;
+}
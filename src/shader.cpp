@@ -1,43 +1,53 @@
 #include <print>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <iterator>
+#include <vector>
+#include <unistd.h>
 #include <GL/glew.h>
 
 #include "shader.h"
+#include "utils.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+namespace {
+
+// FNV-1a, continued over several strings.
+uint64_t hash_text(uint64_t h, const char* text)
 {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    try 
-    {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+    for (; text && *text; ++text) {
+        h ^= static_cast<unsigned char>(*text);
+        h *= 0x100000001B3ull;
     }
-    catch(std::ifstream::failure& e)
-    {
-        std::println("ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: {}", e.what());
+    return h;
+}
+
+bool program_binaries_supported()
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+} // namespace
+
+Shader::Shader(const char* vertexCode, const char* fragmentCode)
+{
+    // 1. reuse the program linked by an earlier run
+    std::string cached;
+    if (program_binaries_supported()) {
+        cached = binary_path(vertexCode, fragmentCode);
+        if (!cached.empty() && load_binary(cached))
+            return;
     }
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+
+    const char* vShaderCode = vertexCode;
+    const char* fShaderCode = fragmentCode;
     // 2. compile shaders
     unsigned int vertex, fragment;
     // vertex shader
@@ -54,11 +64,82 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (!cached.empty())
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
     check_compile_errors(ID, "PROGRAM");
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    if (!cached.empty())
+        save_binary(cached);
+}
+
+// Binaries only load into the driver that made them, so the driver is
+// part of the name along with the sources.
+std::string Shader::binary_path(const char* vertexCode, const char* fragmentCode) const
+{
+    std::string dir = utl::cache_dir();
+    if (dir.empty())
+        return {};
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        h = hash_text(h, reinterpret_cast<const char*>(glGetString(name)));
+    h = hash_text(h, vertexCode);
+    h = hash_text(h, fragmentCode);
+    return std::format("{}/program-{:016x}.bin", dir, h);
+}
+
+// The file holds the binary format followed by the binary.
+bool Shader::load_binary(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    GLenum format = 0;
+    if (!in.read(reinterpret_cast<char*>(&format), sizeof format))
+        return false;
+    std::vector<char> binary{std::istreambuf_iterator<char>(in), {}};
+    if (binary.empty())
+        return false;
+
+    ID = glCreateProgram();
+    glProgramBinary(ID, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Left by another driver version; rebuilt and overwritten
+        glDeleteProgram(ID);
+        ID = 0;
+        return false;
+    }
+    return true;
+}
+
+void Shader::save_binary(const std::string& path) const
+{
+    GLint success = 0, length = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0)
+        return;
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &length, &format, binary.data());
+    if (length <= 0)
+        return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    // Renamed into place, so another instance never loads half a file
+    std::string tmp = std::format("{}.{}", path, getpid());
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&format), sizeof format);
+    out.write(binary.data(), length);
+    out.close();
+    if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::println(std::cerr, "ERROR::SHADER: Could not write {}", path);
+        std::remove(tmp.c_str());
+    }
 }
 
 void Shader::use() 
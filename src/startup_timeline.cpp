@@ -0,0 +1,58 @@
+#include "startup_timeline.h"
+
+#include <algorithm>
+#include <print>
+
+namespace {
+
+// Set during static initialization, before main() runs.
+const StartupTimeline::Clock::time_point process_start =
+    StartupTimeline::Clock::now();
+
+double ms_since_start(StartupTimeline::Clock::time_point t) {
+  return std::chrono::duration<double, std::milli>(t - process_start).count();
+}
+
+} // namespace
+
+StartupTimeline &StartupTimeline::get() {
+  static StartupTimeline timeline;
+  return timeline;
+}
+
+void StartupTimeline::mark(std::string name) {
+  Clock::time_point now = Clock::now();
+  add(std::move(name), now, now);
+}
+
+void StartupTimeline::add(std::string name, Clock::time_point begin,
+                          Clock::time_point end) {
+  std::lock_guard lock(mutex);
+  if (!enabled || reported)
+    return;
+  auto id = std::this_thread::get_id();
+  auto it = std::ranges::find(threads, id);
+  if (it == threads.end())
+    it = threads.insert(it, id);
+  entries.push_back({std::move(name), begin, end,
+                     static_cast<size_t>(it - threads.begin())});
+}
+
+void StartupTimeline::report() {
+  std::lock_guard lock(mutex);
+  if (!enabled || reported)
+    return;
+  reported = true;
+
+  std::ranges::stable_sort(entries, {}, &Entry::begin);
+  std::println("Startup timeline (ms since process start):");
+  for (const Entry &e : entries) {
+    if (e.begin == e.end)
+      std::println("  {:8.2f}             [T{}] {}", ms_since_start(e.begin),
+                   e.thread, e.name);
+    else
+      std::println("  {:8.2f} .. {:8.2f} [T{}] {}", ms_since_start(e.begin),
+                   ms_since_start(e.end), e.thread, e.name);
+  }
+  entries.clear();
+}
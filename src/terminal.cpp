@@ -1,7 +1,12 @@
 #include "terminal.h"
+#include "grapheme.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <utility>
 
 Terminal::Terminal(int width, int height)
     : screen_rows(height),
@@ -10,18 +15,27 @@ Terminal::Terminal(int width, int height)
     screen_buffer.resize(screen_rows);
     for (auto& row : screen_buffer)
         row.resize(screen_cols, Cell{" ", {}});
+    screen_wrapped.assign(screen_rows, 0);
 }
 
 Terminal::~Terminal() = default;
 
 void Terminal::set_window_size(int rows, int cols) {
-    screen_rows = rows;
-    screen_cols = cols;
     term.set_window_size(rows, cols);
 
+    // History lines are stored unwrapped and re-indexed for the new width
+    // on demand (see RowIndex); only the grid has to be rewrapped here.
+    if (cols != screen_cols && rows > 0 && cols > 0) {
+        reflow_screen(rows, cols);
+        return;
+    }
+
+    screen_rows = rows;
+    screen_cols = cols;
     screen_buffer.resize(screen_rows);
     for (auto& row : screen_buffer)
         row.resize(screen_cols, Cell{" ", {}});
+    screen_wrapped.resize(screen_rows, 0);
 }
 
 void Terminal::send_input(const std::string& input) {
@@ -49,6 +63,11 @@ std::string Terminal::poll_output() {
     if (result.empty())
         return result;
 
+    if (lazy_history_mode) {
+        ingest_lazy(result);
+        return result;
+    }
+
     auto actions = parser.parse_input(result);
     process_actions(actions);
     return result;
@@ -67,6 +86,7 @@ void Terminal::process_actions(const std::vector<TerminalAction>& actions) {
                     screen_buffer.resize(screen_rows);
                     for (auto& row : screen_buffer)
                         row.resize(screen_cols, Cell{" ", {}});
+                    screen_wrapped.resize(screen_rows, 0);
                 }
                 screen_cursor_row = 0;
                 screen_cursor_col = 0;
@@ -79,6 +99,12 @@ void Terminal::process_actions(const std::vector<TerminalAction>& actions) {
             continue;
         }
 
+        if (a.type == ActionType::SET_PALETTE_COLOR ||
+            a.type == ActionType::RESET_PALETTE_COLOR) {
+            process_palette(a);
+            continue;
+        }
+
         if (alternate_screen_active)
             process_screen_mode(a);
         else
@@ -86,11 +112,42 @@ void Terminal::process_actions(const std::vector<TerminalAction>& actions) {
     }
 }
 
+// Colour changes apply to both screens and to history already drawn, as
+// cells keep palette slots rather than colours.
+void Terminal::process_palette(const TerminalAction& a) {
+    if (a.type == ActionType::RESET_PALETTE_COLOR) {
+        if (a.row < 0) {
+            for (int slot = 0; slot < Palette::COLORS; ++slot)
+                palette.reset(slot);
+        } else {
+            palette.reset(a.row);
+        }
+        return;
+    }
+
+    if (!a.flag) {
+        const TerminalColor& c = a.attributes.foreground;
+        palette.set(a.row, {c.r, c.g, c.b});
+        return;
+    }
+
+    // Query: answered in the 16-bit form xterm uses
+    const Palette::Rgb& rgb = palette[a.row];
+    std::string which = a.row < Palette::COLORS ? std::format("4;{}", a.row)
+                      : a.row == Palette::FOREGROUND ? "10" : "11";
+    send_input(std::format("\033]{};rgb:{:04x}/{:04x}/{:04x}{}", which,
+                           rgb.r * 257, rgb.g * 257, rgb.b * 257, a.text));
+}
+
 // ------------------------------------------------------------
 // Screen mode
 // ------------------------------------------------------------
 
 void Terminal::process_screen_mode(const TerminalAction& a) {
+    // Anything but more text ends the cluster at the cursor.
+    if (a.type != ActionType::PRINT_TEXT)
+        grapheme.reset();
+
     switch (a.type) {
         case ActionType::PRINT_TEXT:
             handle_print_text(a.text, a.attributes);
@@ -219,11 +276,16 @@ void Terminal::process_screen_mode(const TerminalAction& a) {
 // ------------------------------------------------------------
 
 void Terminal::process_history_mode(const TerminalAction& a) {
-    switch (a.type) {
-        case ActionType::PRINT_TEXT:
-            append_history_text(a.text, a.attributes);
-            break;
+    if (lazy_history_mode) {
+        // Line edits are replayed from the raw bytes when needed.
+        if (a.type == ActionType::CLEAR_SCREEN) {
+            lazy_history.clear();
+            scroll_offset = 0;
+        }
+        return;
+    }
 
+    switch (a.type) {
         case ActionType::NEWLINE:
             finalize_history_line();
             scroll_offset = 0;
@@ -231,61 +293,62 @@ void Terminal::process_history_mode(const TerminalAction& a) {
 
         case ActionType::CLEAR_SCREEN:
             parsed_buffer.clear();
-            active_line = ParsedLine{};
+            active_line.clear();
             scroll_offset = 0;
             break;
 
-        case ActionType::BACKSPACE:
-            backspace_history();
-            break;
-
         default:
+            active_line.apply(a);
             break;
     }
 }
 
-// ------------------------------------------------------------
-// UTF-8 / combining
-// ------------------------------------------------------------
-
-bool Terminal::decode_next_utf8(std::string& pending, std::string& out_char) {
-    if (pending.empty())
-        return false;
-
-    unsigned char b = static_cast<unsigned char>(pending[0]);
-    int needed = 1;
-    if ((b & 0x80) == 0x00)      needed = 1;
-    else if ((b & 0xE0) == 0xC0) needed = 2;
-    else if ((b & 0xF0) == 0xE0) needed = 3;
-    else if ((b & 0xF8) == 0xF0) needed = 4;
+// Lazy ingestion: text runs go straight into LazyHistory; only escape
+// sequences are parsed live, to track attributes and mode switches.
+void Terminal::ingest_lazy(const std::string& bytes) {
+    const char* data = bytes.data();
+    size_t n = bytes.size();
+    size_t pos = 0;
+    std::vector<TerminalAction> actions;
+
+    while (pos < n) {
+        if (parser.idle()) {
+            const void* esc = std::memchr(data + pos, '\033', n - pos);
+            size_t end = esc ? static_cast<size_t>(static_cast<const char*>(esc) - data) : n;
+            if (end > pos) {
+                if (alternate_screen_active) {
+                    process_actions(parser.parse_input(bytes.substr(pos, end - pos)));
+                } else if (lazy_history.append_text(data + pos, end - pos,
+                                                    parser.attributes())) {
+                    scroll_offset = 0;
+                }
+                pos = end;
+                continue;
+            }
+        }
 
-    if (static_cast<int>(pending.size()) < needed)
-        return false;
+        actions.clear();
+        bool was_history = !alternate_screen_active;
+        size_t used = parser.parse_sequence(data + pos, n - pos, actions);
+        process_actions(actions);
+        if (was_history && !alternate_screen_active)
+            lazy_history.append_sequence(data + pos, used);
+        pos += used;
+    }
 
-    out_char = pending.substr(0, needed);
-    pending.erase(0, needed);
-    return true;
+    if (!alternate_screen_active && parser.idle())
+        lazy_history.compact_active(parser.attributes());
 }
 
-uint32_t Terminal::decode_codepoint(const std::string& utf8) const {
-    size_t pos = 0;
-    return utl::get_next_codepoint(utf8, pos);
-}
-
-bool Terminal::is_combining(uint32_t cp) const {
-    if (cp >= 0x0300 && cp <= 0x036F) return true;
-    if (cp == 0x200D || cp == 0x200C) return true;
-    if (cp >= 0x0900 && cp <= 0x097F) {
-        if ((cp >= 0x0900 && cp <= 0x0903) ||
-            (cp >= 0x093A && cp <= 0x094F) ||
-            (cp >= 0x0951 && cp <= 0x0957) ||
-            (cp >= 0x0962 && cp <= 0x0963))
-            return true;
-    }
-    return false;
-}
+// ------------------------------------------------------------
+// UTF-8 / combining
+// ------------------------------------------------------------
 
-void Terminal::apply_combining(const std::string& mark) {
+// Appends a code point to the cluster before the cursor. One that still
+// takes a cell of its own (the second half of a flag) widens the cluster
+// into a continuation cell when there is room.
+void Terminal::apply_combining(std::string_view mark, const TerminalAttributes& attr,
+                               int width) {
     if (screen_cursor_row < 0 || screen_cursor_row >= screen_rows)
         return;
     if (screen_cursor_col < 0 || screen_cursor_col >= screen_cols)
@@ -294,12 +357,24 @@ void Terminal::apply_combining(const std::string& mark) {
     int target_row = screen_cursor_row;
     int target_col = screen_cursor_col;
 
-    if (target_col > 0)
+    // With a wrap pending the cursor still sits on the last character.
+    if (target_col > 0 && !wrap_next)
         --target_col;
 
-    auto& cell = screen_buffer[target_row][target_col];
-    if (!cell.content.empty())
-        cell.content += mark;
+    auto& row = screen_buffer[target_row];
+    if (target_col > 0 && row[target_col].content.empty())
+        --target_col;   // continuation cell: the mark goes on the lead
+
+    auto& cell = row[target_col];
+    if (cell.content.empty())
+        return;
+    cell.content += mark;
+
+    if (width > 0 && !wrap_next && target_col + 1 == screen_cursor_col) {
+        split_wide(target_row, screen_cursor_col);
+        row[screen_cursor_col] = Cell{"", attr};
+        advance_cursor(1);
+    }
 }
 
 // ------------------------------------------------------------
@@ -307,41 +382,58 @@ void Terminal::apply_combining(const std::string& mark) {
 // ------------------------------------------------------------
 
 void Terminal::handle_print_text(const std::string& text, const TerminalAttributes& attr) {
-    pending_utf8 += text;
+    utf8.feed(text, [&](char32_t cp, std::string_view ch) {
+        print_char(cp, ch, attr);
+    });
+}
 
-    std::string ch;
-    while (decode_next_utf8(pending_utf8, ch)) {
-        uint32_t cp = decode_codepoint(ch);
-        bool combining = is_combining(cp);
+// Places one decoded code point: it either starts a new cluster in the next
+// cell(s) or joins the cluster before the cursor.
+void Terminal::print_char(char32_t cp, std::string_view ch, const TerminalAttributes& attr) {
+    int width = static_cast<int>(grapheme.advance(cp));
+    // Zero-width characters never take a cell, even outside a cluster.
+    bool joins = !grapheme.at_boundary() || width == 0;
+    if (screen_cols < 2)
+        width = std::min(width, 1);
 
-        if (auto_wrap_mode && wrap_next && !combining) {
-            wrap_next = false;
-            screen_cursor_col = 0;
-            int bottom = (scroll_region_bottom == -1)
-                         ? screen_rows - 1
-                         : scroll_region_bottom;
-            if (screen_cursor_row == bottom)
-                perform_scroll_up();
-            else if (screen_cursor_row + 1 < screen_rows)
-                ++screen_cursor_row;
-        }
+    // A wide character never straddles the right margin.
+    if (width == 2 && !joins && auto_wrap_mode && screen_cursor_col == screen_cols - 1)
+        wrap_next = true;
 
-        if (combining) {
-            apply_combining(ch);
-        } else {
-            write_char(ch, attr);
-        }
+    if (auto_wrap_mode && wrap_next && !joins) {
+        wrap_next = false;
+        if (screen_cursor_row >= 0 && screen_cursor_row < screen_rows)
+            screen_wrapped[screen_cursor_row] = 1;
+        screen_cursor_col = 0;
+        int bottom = (scroll_region_bottom == -1)
+                     ? screen_rows - 1
+                     : scroll_region_bottom;
+        if (screen_cursor_row == bottom)
+            perform_scroll_up();
+        else if (screen_cursor_row + 1 < screen_rows)
+            ++screen_cursor_row;
+    }
+
+    if (joins) {
+        apply_combining(ch, attr, width);
+    } else {
+        write_char(ch, attr, width);
     }
 }
 
 
-void Terminal::write_char(const std::string& utf8, const TerminalAttributes& attr) {
+// Wide characters take a lead cell holding the text and a continuation
+// cell with empty content right after it.
+void Terminal::write_char(std::string_view utf8, const TerminalAttributes& attr,
+                          int width) {
     // Bounds check
     if (screen_cursor_row < 0 || screen_cursor_row >= screen_rows)
         return;
 
     if (screen_cursor_col >= screen_cols)
         screen_cursor_col = screen_cols - 1;
+    if (screen_cursor_col + width > screen_cols)
+        screen_cursor_col = screen_cols - width;   // no auto-wrap
 
     auto& row = screen_buffer[screen_cursor_row];
 
@@ -356,7 +448,7 @@ void Terminal::write_char(const std::string& utf8, const TerminalAttributes& att
         return;
     }
 
-    std::string ch = utf8;
+    std::string ch(utf8);
 
     // Space is a visible blank cell
     if (ch == " ") {
@@ -367,28 +459,52 @@ void Terminal::write_char(const std::string& utf8, const TerminalAttributes& att
     // Insert mode vs overwrite mode
     // ------------------------------------------------------------
     if (insert_mode) {
-        if (screen_cursor_col <= screen_cols) {
-            row.insert(row.begin() + screen_cursor_col, Cell{ch, attr});
-            if (row.size() > static_cast<size_t>(screen_cols))
-                row.pop_back();
-        }
+        split_wide(screen_cursor_row, screen_cursor_col);
+        row.insert(row.begin() + screen_cursor_col, width, Cell{"", attr});
+        row.resize(screen_cols);
+        if (utl::text_width(row.back().content) == 2)
+            row.back() = Cell{" ", row.back().attributes};   // pushed half off
     } else {
-        if (screen_cursor_col < screen_cols)
-            row[screen_cursor_col] = Cell{ch, attr};
+        // Overwriting half of a wide character blanks the other half.
+        for (int c = screen_cursor_col; c < screen_cursor_col + width; ++c)
+            split_wide(screen_cursor_row, c);
     }
+    row[screen_cursor_col] = Cell{ch, attr};
+    if (width == 2)
+        row[screen_cursor_col + 1] = Cell{"", attr};
 
-    // ------------------------------------------------------------
-    // Cursor advance + wrap logic
-    // ------------------------------------------------------------
-    if (screen_cursor_col + 1 >= screen_cols) {
+    advance_cursor(width);
+}
+
+// Moves the cursor past `width` cells just written; at the right margin it
+// stays on the last column with a wrap pending.
+void Terminal::advance_cursor(int width) {
+    if (screen_cursor_col + width >= screen_cols) {
+        screen_cursor_col = screen_cols - 1;
         if (auto_wrap_mode)
             wrap_next = true;
     } else {
-        ++screen_cursor_col;
+        screen_cursor_col += width;
         wrap_next = false;
     }
 }
 
+// Blanks the other half of a wide character that covers cell `col`.
+void Terminal::split_wide(int row, int col) {
+    auto& cells = screen_buffer[row];
+    if (col < 0 || col >= static_cast<int>(cells.size()))
+        return;
+
+    if (cells[col].content.empty()) {
+        if (col > 0)
+            cells[col - 1] = Cell{" ", cells[col - 1].attributes};
+        cells[col] = Cell{" ", cells[col].attributes};
+    } else if (col + 1 < static_cast<int>(cells.size()) &&
+               cells[col + 1].content.empty()) {
+        cells[col + 1] = Cell{" ", cells[col + 1].attributes};
+    }
+}
+
 
 void Terminal::newline() {
     int bottom = (scroll_region_bottom == -1) ? screen_rows - 1 : scroll_region_bottom;
@@ -425,6 +541,7 @@ void Terminal::clear_screen(int mode, const TerminalAttributes& attr) {
     if (mode == 2 || mode == 3) {
         for (auto& row : screen_buffer)
             std::fill(row.begin(), row.end(), Cell{" ", attr});
+        std::fill(screen_wrapped.begin(), screen_wrapped.end(), 0);
     } else if (mode == 0) {
         if (screen_cursor_row < screen_rows) {
             auto& row = screen_buffer[screen_cursor_row];
@@ -433,9 +550,13 @@ void Terminal::clear_screen(int mode, const TerminalAttributes& attr) {
         }
         for (int r = screen_cursor_row + 1; r < screen_rows; ++r)
             std::fill(screen_buffer[r].begin(), screen_buffer[r].end(), Cell{" ", attr});
+        for (int r = std::max(screen_cursor_row, 0); r < screen_rows; ++r)
+            screen_wrapped[r] = 0;
     } else if (mode == 1) {
-        for (int r = 0; r < screen_cursor_row; ++r)
+        for (int r = 0; r < screen_cursor_row; ++r) {
             std::fill(screen_buffer[r].begin(), screen_buffer[r].end(), Cell{" ", attr});
+            screen_wrapped[r] = 0;
+        }
         if (screen_cursor_row < screen_rows) {
             auto& row = screen_buffer[screen_cursor_row];
             for (int i = 0; i <= screen_cursor_col && i < screen_cols; ++i)
@@ -452,11 +573,13 @@ void Terminal::clear_line(int mode, const TerminalAttributes& attr) {
     if (mode == 0) {
         for (int i = screen_cursor_col; i < screen_cols; ++i)
             row[i] = Cell{" ", attr};
+        screen_wrapped[screen_cursor_row] = 0;
     } else if (mode == 1) {
         for (int i = 0; i <= screen_cursor_col && i < screen_cols; ++i)
             row[i] = Cell{" ", attr};
     } else if (mode == 2) {
         std::fill(row.begin(), row.end(), Cell{" ", attr});
+        screen_wrapped[screen_cursor_row] = 0;
     }
 }
 
@@ -475,6 +598,8 @@ void Terminal::insert_lines(int count, const TerminalAttributes& attr) {
             screen_buffer.erase(screen_buffer.begin() + bottom);
             screen_buffer.insert(screen_buffer.begin() + screen_cursor_row,
                                  std::vector<Cell>(screen_cols, Cell{" ", attr}));
+            screen_wrapped.erase(screen_wrapped.begin() + bottom);
+            screen_wrapped.insert(screen_wrapped.begin() + screen_cursor_row, 0);
         }
     }
 }
@@ -494,6 +619,8 @@ void Terminal::delete_lines(int count, const TerminalAttributes& attr) {
             screen_buffer.erase(screen_buffer.begin() + screen_cursor_row);
             screen_buffer.insert(screen_buffer.begin() + bottom,
                                  std::vector<Cell>(screen_cols, Cell{" ", attr}));
+            screen_wrapped.erase(screen_wrapped.begin() + screen_cursor_row);
+            screen_wrapped.insert(screen_wrapped.begin() + bottom, 0);
         }
     }
 }
@@ -547,6 +674,8 @@ void Terminal::perform_scroll_up() {
     screen_buffer.erase(screen_buffer.begin() + top);
     screen_buffer.insert(screen_buffer.begin() + bottom,
                          std::vector<Cell>(screen_cols, Cell{" ", {}}));
+    screen_wrapped.erase(screen_wrapped.begin() + top);
+    screen_wrapped.insert(screen_wrapped.begin() + bottom, 0);
 }
 
 void Terminal::perform_scroll_down() {
@@ -559,73 +688,169 @@ void Terminal::perform_scroll_down() {
 
     screen_buffer.insert(screen_buffer.begin() + top,
                          std::vector<Cell>(screen_cols, Cell{" ", {}}));
-    if (bottom + 1 < screen_rows)
+    screen_wrapped.insert(screen_wrapped.begin() + top, 0);
+    if (bottom + 1 < screen_rows) {
         screen_buffer.erase(screen_buffer.begin() + bottom + 1);
-    else
+        screen_wrapped.erase(screen_wrapped.begin() + bottom + 1);
+    } else {
         screen_buffer.pop_back();
+        screen_wrapped.pop_back();
+    }
 }
 
-// ------------------------------------------------------------
-// History mode helpers
-// ------------------------------------------------------------
+// Rewraps the grid at a new width. Rows joined by auto-wrap (see
+// screen_wrapped) form one logical line; trailing blanks are dropped so a
+// narrowed line does not spill padding onto extra rows. The cursor keeps
+// its place in its logical line, and rows are dropped from the top if the
+// result is too tall.
+void Terminal::reflow_screen(int rows, int cols) {
+    auto blank = [](const Cell& c) {
+        return c.content == " " &&
+               c.attributes.background.type == TerminalColor::Type::DEFAULT &&
+               !c.attributes.reverse;
+    };
 
-void Terminal::append_history_text(const std::string& text, const TerminalAttributes& attr) {
-    if (active_line.segments.empty()) {
-        active_line.segments.push_back({text, attr});
-        return;
+    std::vector<std::vector<Cell>> lines;
+    std::vector<Cell> current;
+    size_t cursor_line = SIZE_MAX;
+    size_t cursor_offset = 0;
+
+    for (size_t r = 0; r < screen_buffer.size(); ++r) {
+        if (static_cast<int>(r) == screen_cursor_row) {
+            cursor_line = lines.size();
+            // A pending wrap means the cursor is logically one past the edge.
+            cursor_offset = current.size() + static_cast<size_t>(screen_cursor_col) +
+                            (wrap_next ? 1 : 0);
+        }
+
+        current.insert(current.end(), screen_buffer[r].begin(), screen_buffer[r].end());
+
+        bool wrapped = r < screen_wrapped.size() && screen_wrapped[r];
+        if (wrapped && r + 1 < screen_buffer.size())
+            continue;
+
+        size_t keep = current.size();
+        while (keep > 0 && blank(current[keep - 1]))
+            --keep;
+        if (cursor_line == lines.size())
+            keep = std::max(keep, std::min(cursor_offset, current.size()));
+        current.resize(keep);
+        lines.push_back(std::move(current));
+        current.clear();
     }
 
-    auto& last = active_line.segments.back();
+    size_t width = static_cast<size_t>(cols);
+    std::vector<std::vector<Cell>> grid;
+    std::vector<uint8_t> wrapped;
+    size_t cursor_row = 0;
+    size_t cursor_col = 0;
+    bool pending_wrap = false;
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const auto& line = lines[i];
+        // Row breaks; a wide character moves whole to the next row.
+        std::vector<size_t> starts{0};
+        while (line.size() - starts.back() > width) {
+            size_t end = starts.back() + width;
+            if (line[end].content.empty() && end - starts.back() > 1)
+                --end;
+            starts.push_back(end);
+        }
 
-    auto same_color = [](const TerminalColor& a, const TerminalColor& b) {
-        return a.type == b.type &&
-               a.ansi_color == b.ansi_color &&
-               a.indexed_color == b.indexed_color &&
-               a.r == b.r && a.g == b.g && a.b == b.b;
-    };
+        if (i == cursor_line) {
+            size_t r = static_cast<size_t>(
+                std::upper_bound(starts.begin(), starts.end(), cursor_offset) - starts.begin()) - 1;
+            cursor_col = cursor_offset - starts[r];
+            if (cursor_col >= width) {
+                cursor_col = width - 1;
+                pending_wrap = true;
+            }
+            cursor_row = grid.size() + r;
+        }
 
-    bool same_fg = same_color(last.attributes.foreground, attr.foreground);
-    bool same_bg = same_color(last.attributes.background, attr.background);
+        for (size_t c = 0; c < starts.size(); ++c) {
+            size_t end = c + 1 < starts.size() ? starts[c + 1] : line.size();
+            std::vector<Cell> row(line.begin() + static_cast<std::ptrdiff_t>(starts[c]),
+                                  line.begin() + static_cast<std::ptrdiff_t>(end));
+            row.resize(width, Cell{" ", {}});
+            grid.push_back(std::move(row));
+            wrapped.push_back(c + 1 < starts.size());
+        }
+    }
 
-    if (same_fg && same_bg && last.attributes.bold == attr.bold) {
-        last.content += text;
-    } else {
-        active_line.segments.push_back({text, attr});
+    // Too tall: drop blank rows below the cursor first, then from the top.
+    size_t height = static_cast<size_t>(rows);
+    while (grid.size() > height && grid.size() - 1 > cursor_row &&
+           std::all_of(grid.back().begin(), grid.back().end(), blank)) {
+        grid.pop_back();
+        wrapped.pop_back();
+    }
+    if (grid.size() > height) {
+        size_t drop = std::min(grid.size() - height, cursor_row);
+        grid.erase(grid.begin(), grid.begin() + static_cast<std::ptrdiff_t>(drop));
+        wrapped.erase(wrapped.begin(), wrapped.begin() + static_cast<std::ptrdiff_t>(drop));
+        cursor_row -= drop;
     }
+    grid.resize(height, std::vector<Cell>(width, Cell{" ", {}}));
+    wrapped.resize(height, 0);
+
+    screen_buffer  = std::move(grid);
+    screen_wrapped = std::move(wrapped);
+    screen_rows = rows;
+    screen_cols = cols;
+    screen_cursor_row = static_cast<int>(std::min(cursor_row, height - 1));
+    screen_cursor_col = static_cast<int>(cursor_col);
+    wrap_next = pending_wrap;
+
+    scroll_region_top = 0;
+    scroll_region_bottom = -1;
+    saved_cursor_row = std::clamp(saved_cursor_row, 0, screen_rows - 1);
+    saved_cursor_col = std::clamp(saved_cursor_col, 0, screen_cols - 1);
 }
 
+// ------------------------------------------------------------
+// History mode helpers
+// ------------------------------------------------------------
+
 void Terminal::finalize_history_line() {
-    parsed_buffer.push_back(active_line);
-    active_line = ParsedLine{};
+    parsed_buffer.push_back(active_line.line());
+    active_line.clear();
 }
 
-void Terminal::backspace_history() {
-    if (active_line.segments.empty())
-        return;
+size_t Terminal::history_size() const {
+    return lazy_history_mode ? lazy_history.size() : parsed_buffer.size();
+}
 
-    auto& last = active_line.segments.back();
-    if (last.content.empty()) {
-        active_line.segments.pop_back();
-        return;
-    }
+LineView Terminal::history_line(size_t i) const {
+    return lazy_history_mode ? lazy_history[i] : parsed_buffer[i];
+}
 
-    while (!last.content.empty()) {
-        unsigned char c = static_cast<unsigned char>(last.content.back());
-        last.content.pop_back();
-        if ((c & 0xC0) != 0x80)
-            break;
-    }
+const RowIndex& Terminal::history_rows() const {
+    return lazy_history_mode ? lazy_history.rows() : parsed_buffer.rows();
+}
 
-    if (last.content.empty())
-        active_line.segments.pop_back();
+const ActiveLine& Terminal::current_line() const {
+    return lazy_history_mode ? lazy_history.active() : active_line;
 }
 
 // ------------------------------------------------------------
 // Scrolling API
 // ------------------------------------------------------------
 
+// scroll_offset counts wrapped visual rows, not logical lines.
+int Terminal::max_scroll_offset() const {
+    size_t cols = static_cast<size_t>(std::max(screen_cols, 1));
+    const RowIndex& index = history_rows();
+    // While the index is rebuilt in the background every line counts as one
+    // row; the renderer re-anchors once it is ready.
+    size_t history = index.ready(cols) ? index.total(cols) : index.size();
+    size_t rows = history + current_line().rows(cols);
+    size_t visible = static_cast<size_t>(visible_rows());
+    return rows > visible ? static_cast<int>(rows - visible) : 0;
+}
+
 void Terminal::scroll_up() {
-    if (scroll_offset < static_cast<int>(parsed_buffer.size()))
+    if (scroll_offset < max_scroll_offset())
         ++scroll_offset;
 }
 
@@ -635,13 +860,11 @@ void Terminal::scroll_down() {
 }
 
 void Terminal::scroll_page_up() {
-    scroll_offset += screen_rows;
-    if (scroll_offset > static_cast<int>(parsed_buffer.size()))
-        scroll_offset = static_cast<int>(parsed_buffer.size());
+    scroll_offset = std::min(scroll_offset + visible_rows(), max_scroll_offset());
 }
 
 void Terminal::scroll_page_down() {
-    scroll_offset -= screen_rows;
+    scroll_offset -= visible_rows();
     if (scroll_offset < 0)
         scroll_offset = 0;
 }
@@ -650,3 +873,21 @@ void Terminal::scroll_to_bottom() {
     scroll_offset = 0;
 }
 
+void Terminal::set_scrollback_limits(size_t max_lines, size_t max_bytes) {
+    parsed_buffer.set_limits(max_lines, max_bytes);
+    lazy_history.set_limits(max_lines, max_bytes);
+    scroll_offset = std::clamp(scroll_offset, 0, max_scroll_offset());
+}
+
+bool Terminal::enable_disk_scrollback(bool keep_file) {
+    return parsed_buffer.enable_disk_backing("", keep_file);
+}
+
+void Terminal::set_lazy_history(bool enable) {
+    lazy_history_mode = enable;
+    parsed_buffer.clear();
+    lazy_history.clear();
+    active_line.clear();
+    scroll_offset = 0;
+}
+
@@ -1,5 +1,8 @@
 #include "terminal_parser.h"
+#include "palette.h"
 #include "utils.h"
+#include <charconv>
+#include <format>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -31,12 +34,44 @@ TerminalParser::TerminalParser() {
 std::vector<TerminalAction>
 TerminalParser::parse_input(const std::string &input) {
   std::vector<TerminalAction> actions;
-  for (char c : input) {
-    process_char(c, actions);
+  size_t i = 0;
+  while (i < input.size()) {
+    // A run of printable bytes becomes a single PRINT_TEXT; the terminal
+    // decodes it as one UTF-8 stream.
+    if (state == State::NORMAL && (unsigned char)input[i] >= 32) {
+      size_t end = i + 1;
+      while (end < input.size() && (unsigned char)input[end] >= 32)
+        ++end;
+      actions.push_back({ActionType::PRINT_TEXT, input.substr(i, end - i),
+                         current_attributes});
+      i = end;
+      continue;
+    }
+    process_char(input[i++], actions);
   }
   return actions;
 }
 
+size_t TerminalParser::parse_sequence(const char *data, size_t len,
+                                      std::vector<TerminalAction> &actions) {
+  size_t i = 0;
+  while (i < len) {
+    process_char(data[i++], actions);
+    if (state == State::NORMAL)
+      break;
+  }
+  return i;
+}
+
+void TerminalParser::reset(const TerminalAttributes &attrs) {
+  state = State::NORMAL;
+  escape_buf.clear();
+  csi_args.clear();
+  str_buf.clear();
+  csi_priv = false;
+  current_attributes = attrs;
+}
+
 void TerminalParser::process_char(char c,
                                   std::vector<TerminalAction> &actions) {
   if (state == State::NORMAL) {
@@ -62,7 +97,7 @@ void TerminalParser::process_char(char c,
   } else if (state == State::CSI) {
     handle_csi(c, actions);
   } else if (state == State::STR) {
-    handle_str(c);
+    handle_str(c, actions);
   } else if (state == State::ALT_CHARSET) {
     // Just consume one character (the charset designator) and return to normal
     state = State::NORMAL;
@@ -79,6 +114,7 @@ void TerminalParser::handle_escape(char c,
   } else if (c == ']' || c == 'P' || c == '_' || c == '^' || c == 'X') {
     // OSC, DCS, APC, PM, SOS - Start string sequence
     state = State::STR;
+    str_kind = c;
     str_buf.clear();
   } else if (c == '(' || c == ')') {
     state = State::ALT_CHARSET;
@@ -291,16 +327,129 @@ void TerminalParser::handle_csi(char c, std::vector<TerminalAction> &actions) {
   }
 }
 
-void TerminalParser::handle_str(char c) {
+void TerminalParser::handle_str(char c, std::vector<TerminalAction> &actions) {
   if (c == '\007' ||
       (c == '\\' && !str_buf.empty() && str_buf.back() == '\033')) {
     // End of string sequence (BEL or ST)
     state = State::NORMAL;
+    if (c == '\\')
+      str_buf.pop_back();
+    if (str_kind == ']')
+      handle_osc(str_buf, c == '\007' ? "\007" : "\033\\", actions);
   } else {
     str_buf += c;
   }
 }
 
+// Colour sequences only; other OSCs (window title and so on) are ignored.
+// Replies end with `terminator`, the one the request used.
+void TerminalParser::handle_osc(std::string_view body,
+                                std::string_view terminator,
+                                std::vector<TerminalAction> &actions) {
+  std::vector<std::string_view> fields;
+  while (true) {
+    size_t semi = body.find(';');
+    fields.push_back(body.substr(0, semi));
+    if (semi == std::string_view::npos)
+      break;
+    body.remove_prefix(semi + 1);
+  }
+
+  auto number = [](std::string_view text, int &out) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc() && end == text.data() + text.size();
+  };
+  auto set = [&](int slot, std::string_view spec) {
+    TerminalAction action{ActionType::SET_PALETTE_COLOR};
+    action.row = slot;
+    action.flag = spec == "?";
+    if (action.flag)
+      action.text = terminator;
+    if (action.flag || parse_color_spec(spec, action.attributes.foreground))
+      actions.push_back(action);
+  };
+  auto reset = [&](int slot) {
+    TerminalAction action{ActionType::RESET_PALETTE_COLOR};
+    action.row = slot;
+    actions.push_back(action);
+  };
+
+  int code;
+  if (!number(fields[0], code))
+    return;
+  switch (code) {
+  case 4: // OSC 4 ; index ; spec [; index ; spec ...]
+    for (size_t i = 1; i + 1 < fields.size(); i += 2) {
+      int index;
+      if (number(fields[i], index) && index >= 0 && index < Palette::COLORS)
+        set(index, fields[i + 1]);
+    }
+    break;
+  case 10: // OSC 10 ; fg [; bg], each further spec setting the next slot
+  case 11: {
+    int slot = code == 10 ? Palette::FOREGROUND : Palette::BACKGROUND;
+    for (size_t i = 1; i < fields.size() && slot <= Palette::BACKGROUND; ++i)
+      set(slot++, fields[i]);
+  } break;
+  case 104: // OSC 104 [; index ...]
+    if (fields.size() == 1 || (fields.size() == 2 && fields[1].empty()))
+      reset(-1);
+    for (size_t i = 1; i < fields.size(); ++i) {
+      int index;
+      if (number(fields[i], index) && index >= 0 && index < Palette::COLORS)
+        reset(index);
+    }
+    break;
+  case 110:
+    reset(Palette::FOREGROUND);
+    break;
+  case 111:
+    reset(Palette::BACKGROUND);
+    break;
+  }
+}
+
+// "rgb:R/G/B" with one to four hex digits per channel, or "#RRGGBB".
+bool TerminalParser::parse_color_spec(std::string_view spec,
+                                      TerminalColor &color) {
+  auto channel = [](std::string_view hex, uint8_t &out) {
+    if (hex.empty() || hex.size() > 4)
+      return false;
+    unsigned value;
+    auto [end, ec] = std::from_chars(hex.data(), hex.data() + hex.size(), value, 16);
+    if (ec != std::errc() || end != hex.data() + hex.size())
+      return false;
+    // Scale from hex.size() digits to eight bits
+    unsigned max = (1u << (4 * hex.size())) - 1;
+    out = static_cast<uint8_t>((value * 255 + max / 2) / max);
+    return true;
+  };
+
+  uint8_t r, g, b;
+  if (spec.starts_with("rgb:")) {
+    spec.remove_prefix(4);
+    size_t s1 = spec.find('/');
+    size_t s2 = s1 == std::string_view::npos ? s1 : spec.find('/', s1 + 1);
+    if (s2 == std::string_view::npos ||
+        !channel(spec.substr(0, s1), r) ||
+        !channel(spec.substr(s1 + 1, s2 - s1 - 1), g) ||
+        !channel(spec.substr(s2 + 1), b))
+      return false;
+  } else if (spec.size() == 7 && spec[0] == '#') {
+    if (!channel(spec.substr(1, 2), r) || !channel(spec.substr(3, 2), g) ||
+        !channel(spec.substr(5, 2), b))
+      return false;
+  } else {
+    return false;
+  }
+
+  color.type = TerminalColor::Type::RGB;
+  color.r = r;
+  color.g = g;
+  color.b = b;
+  return true;
+}
+
 void TerminalParser::update_attributes(const std::vector<int> &params) {
   if (params.empty()) {
     update_attributes_from_code(0);
@@ -429,6 +578,73 @@ AnsiColor TerminalParser::parse_color_code(int code) {
   }
 }
 
+namespace {
+
+// Codes are emitted so the colour's type is set last: earlier codes only
+// restore fields left behind by a previous colour of another type.
+void encode_color(std::string &out, const TerminalColor &c, bool fg) {
+  if (c.type == TerminalColor::Type::DEFAULT)
+    return;
+
+  const TerminalColor def;
+  int base = fg ? 30 : 40;
+  auto rgb = [&] {
+    out += std::format(";{};2;{};{};{}", base + 8, c.r, c.g, c.b);
+  };
+  auto indexed = [&] {
+    out += std::format(";{};5;{}", base + 8, c.indexed_color);
+  };
+  auto ansi = [&] {
+    int i = static_cast<int>(c.ansi_color);
+    if (c.ansi_color != AnsiColor::RESET)
+      out += std::format(";{}", i < 8 ? base + i : base + 60 + i - 8);
+  };
+
+  if (c.type != TerminalColor::Type::RGB &&
+      (c.r != def.r || c.g != def.g || c.b != def.b))
+    rgb();
+  if (c.type != TerminalColor::Type::INDEXED && c.indexed_color != def.indexed_color)
+    indexed();
+  if (c.type != TerminalColor::Type::ANSI && c.ansi_color != def.ansi_color)
+    ansi();
+
+  switch (c.type) {
+  case TerminalColor::Type::RGB:
+    rgb();
+    break;
+  case TerminalColor::Type::INDEXED:
+    indexed();
+    break;
+  case TerminalColor::Type::ANSI:
+    ansi();
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace
+
+std::string TerminalParser::encode_attributes(const TerminalAttributes &attrs) {
+  std::string out = "\033[0";
+  if (attrs.bold)
+    out += ";1";
+  if (attrs.italic)
+    out += ";3";
+  if (attrs.underline)
+    out += ";4";
+  if (attrs.blink)
+    out += ";5";
+  if (attrs.reverse)
+    out += ";7";
+  if (attrs.strikethrough)
+    out += ";9";
+  encode_color(out, attrs.foreground, true);
+  encode_color(out, attrs.background, false);
+  out += 'm';
+  return out;
+}
+
 // Stubs for deprecated/unused methods
 std::vector<ParsedLine>
 TerminalParser::parse_output(const std::string &output) {
@@ -1,10 +1,13 @@
 #include "terminal_view.h"
+#include "grapheme.h"
 #include "oglutil.h"
 #include "utils.h"
 
 #include <algorithm>
 #include <cmath>
+#include <optional>
 #include <iostream>
+#include <tuple>
 
 TerminalView::TerminalView(Terminal& term)
     : terminal(term)
@@ -23,9 +26,11 @@ void TerminalView::set_window_size(float width, float height) {
     win_width  = width;
     win_height = height;
 
+    // Pixel-only changes keep the grid; the PTY only hears about new sizes.
     int rows = static_cast<int>(height / LINE_HEIGHT);
     int cols = static_cast<int>(width  / CELL_WIDTH);
-    terminal.set_window_size(rows, cols);
+    if (rows != terminal.rows() || cols != terminal.cols())
+        terminal.set_window_size(rows, cols);
 }
 
 void TerminalView::update_dimensions() {
@@ -34,6 +39,19 @@ void TerminalView::update_dimensions() {
 
     CELL_WIDTH  = text_renderer->get_char_width();
     LINE_HEIGHT = text_renderer->get_line_height();
+    BASELINE    = text_renderer->get_baseline();
+}
+
+void TerminalView::zoom(int steps) {
+    if (!text_renderer)
+        return;
+
+    constexpr int STEP = 2;   // pixels
+    int size = steps == 0
+        ? int(TextRenderer::DEFAULT_PIXEL_SIZE)
+        : int(text_renderer->get_pixel_size()) + steps * STEP;
+    text_renderer->set_pixel_size(unsigned(std::max(size, 1)));
+    update_dimensions();
 }
 
 void TerminalView::update_cursor_blink() {
@@ -45,11 +63,21 @@ void TerminalView::update_cursor_blink() {
 }
 
 void TerminalView::render() {
+    // A changed palette (OSC 4/10/11) is one upload; cells keep their slots
+    if (text_renderer && terminal.palette.version() != palette_version) {
+        text_renderer->set_palette(terminal.palette.data(), Palette::SIZE);
+        const Palette::Rgb& bg = terminal.palette[Palette::BACKGROUND];
+        glClearColor(bg.r / 255.0f, bg.g / 255.0f, bg.b / 255.0f, 1.0f);
+        palette_version = terminal.palette.version();
+    }
     glClear(GL_COLOR_BUFFER_BIT);
 
     if (!text_renderer)
         return;
 
+    script_runs.next_frame();
+    text_renderer->next_frame();
+
     if (terminal.alternate_screen_active) {
         render_alternate_screen();
     } else {
@@ -58,7 +86,7 @@ void TerminalView::render() {
 
     if (!terminal.get_preedit().empty()) {
         render_preedit(cursor_pos.x, cursor_pos.y);
-    } else if (cursor_visible && terminal.cursor_visible) {
+    } else if (cursor_visible && cursor_in_view && terminal.cursor_visible) {
         render_cursor(cursor_pos.x, cursor_pos.y);
     }
 }
@@ -125,6 +153,7 @@ void TerminalView::render_alternate_screen() {
         y -= LINE_HEIGHT;
     }
 
+    cursor_in_view = true;
     cursor_pos.x = 25.0f + terminal.screen_cursor_col * CELL_WIDTH;
     cursor_pos.y = win_height - LINE_HEIGHT - terminal.screen_cursor_row * LINE_HEIGHT;
 }
@@ -135,66 +164,153 @@ void TerminalView::render_alternate_screen() {
 void TerminalView::render_history_mode() {
     float start_y = win_height - LINE_HEIGHT;
     cursor_pos     = {25.0f, start_y};
+    cursor_in_view = false;
+
+    // Positions are in wrapped visual rows. The history's row index maps
+    // the first visible row to (line, sub-row) in O(log n), so a frame only
+    // touches the lines it draws; a long line is entered at the run that
+    // holds its first visible row.
+    size_t cols     = static_cast<size_t>(std::max(terminal.screen_cols, 1));
+    size_t max_rows = static_cast<size_t>(terminal.visible_rows());
+
+    const RowIndex& index    = terminal.history_rows();
+    const ActiveLine& active = terminal.current_line();
+
+    size_t lines      = terminal.history_size();
+    size_t line       = 0;
+    size_t sub_row    = 0;
+    size_t active_row = 0;
+
+    if (index.ready(cols)) {
+        size_t history_rows = index.total(cols);
+        size_t total_rows   = history_rows + active.rows(cols);
+
+        // The index was rebuilt for a new width: keep the line that was at
+        // the top while it was pending at the top now.
+        if (anchored) {
+            size_t top = index.rows_before(cols, std::min(top_line, lines));
+            terminal.scroll_offset = total_rows > max_rows + top
+                ? static_cast<int>(total_rows - max_rows - top) : 0;
+            anchored = false;
+        }
 
-    size_t total_lines = terminal.parsed_buffer.size() + 1;
-    size_t max_lines   = (win_height / LINE_HEIGHT) - 1;
-
-    int max_offset = 0;
-    if (total_lines > max_lines) {
-        max_offset = static_cast<int>(total_lines - max_lines);
-    }
+        terminal.scroll_offset =
+            std::clamp(terminal.scroll_offset, 0, terminal.max_scroll_offset());
 
-    terminal.scroll_offset =
-        std::clamp(terminal.scroll_offset, 0, max_offset);
+        size_t first_row = 0;
+        if (total_rows > max_rows) {
+            first_row = total_rows - max_rows - terminal.scroll_offset;
+        }
 
-    size_t start_index = 0;
-    if (total_lines > max_lines) {
-        start_index = total_lines - max_lines - terminal.scroll_offset;
+        std::tie(line, sub_row) = index.locate(cols, first_row);
+        active_row = first_row > history_rows ? first_row - history_rows : 0;
+    } else if (terminal.scroll_offset == 0 && !anchored) {
+        // Row index still rebuilding: fill the screen upwards from the
+        // bottom using only the lines that end up visible.
+        size_t active_rows = active.rows(cols);
+        size_t need = max_rows > active_rows ? max_rows - active_rows : 0;
+        active_row  = active_rows > max_rows ? active_rows - max_rows : 0;
+
+        line = lines;
+        while (line > 0 && need > 0) {
+            size_t rows = index.rows_at(line - 1, cols);
+            --line;
+            if (rows >= need) {
+                sub_row = rows - need;
+                break;
+            }
+            need -= rows;
+        }
+    } else {
+        // Scrolled back while rebuilding: move the top line by whole lines.
+        int delta = terminal.scroll_offset - anchor_offset;
+        size_t top = std::min(top_line, lines);
+        if (delta > 0)
+            top -= std::min(top, static_cast<size_t>(delta));
+        else
+            top = std::min(top + static_cast<size_t>(-delta), lines);
+        line = top;
+        anchored = true;
     }
 
+    top_line      = line;
+    anchor_offset = terminal.scroll_offset;
+
     float y = start_y;
+    float last_y = start_y - static_cast<float>(max_rows - 1) * LINE_HEIGHT;
 
-    for (size_t i = 0; i < terminal.parsed_buffer.size(); ++i) {
-        if (i >= start_index && i < start_index + max_lines)
-            render_line(terminal.parsed_buffer[i], y);
+    for (; line < lines && y >= last_y; ++line) {
+        size_t from = sub_row ? index.row_start(line, cols, sub_row) : 0;
+        render_line(terminal.history_line(line), y, from);
+        sub_row = 0;
     }
 
-    if (terminal.parsed_buffer.size() >= start_index &&
-        terminal.parsed_buffer.size() < start_index + max_lines) {
+    if (line == lines && y >= last_y) {
+        const auto& segments = active.line().segments;
+
+        ActiveLine::Position from = active.row_start(cols, active_row);
 
         float active_y = y;
-        render_line(terminal.active_line, y);
+        float x = 25.0f;
+        for (size_t s = from.segment; s < segments.size(); ++s) {
+            std::string_view content = segments[s].content;
+            if (s == from.segment)
+                content.remove_prefix(from.byte);
+            render_segment(content, segments[s].attributes, x, y);
+        }
+        y -= LINE_HEIGHT;
 
         float cx = 25.0f;
         float cy = active_y;
         float limit = 25.0f + terminal.screen_cols * CELL_WIDTH;
 
-        for (const auto& seg : terminal.active_line.segments) {
-            for (const auto& chunk : utl::split_by_devanagari(seg.content)) {
-                size_t pos = 0;
-                unsigned int cp = utl::get_next_codepoint(chunk, pos);
-
-                if (utl::is_devanagari(cp)) {
-                    float w = text_renderer->measure_text_width(chunk, 1.0f);
-                    if (cx + w > limit) {
-                        cy -= LINE_HEIGHT;
-                        cx = 25.0f;
-                    }
-                    cx += w;
+        // Walk up to the cursor column, which is not the end of the line
+        // after a \r or cursor-left. A cursor on a wrap row above the top
+        // of the view is not drawn.
+        std::optional<size_t> offset = active.cursor_offset(from);
+        cursor_in_view = offset.has_value();
+        size_t remaining = offset.value_or(0);
+        auto advance = [&](float w) {
+            if (cx + w > limit) {
+                cy -= LINE_HEIGHT;
+                cx = 25.0f;
+            }
+            cx += w;
+        };
+
+        for (size_t s = from.segment; s < segments.size() && remaining > 0; ++s) {
+            std::string_view content = segments[s].content;
+            if (s == from.segment)
+                content.remove_prefix(from.byte);
+            for (const utl::ScriptRun& run : script_runs.runs(content)) {
+                if (remaining == 0)
+                    break;
+                std::string_view chunk = content.substr(run.begin, run.end - run.begin);
+
+                if (utl::needs_shaping(run.script)) {
+                    size_t n = 0;
+                    size_t p = 0;
+                    while (p < chunk.size() && n < remaining)
+                        n += utl::next_cluster(chunk, p);
+                    advance(text_renderer->measure_text_width(chunk.substr(0, p), 1.0f,
+                                                              run.script));
+                    remaining -= std::min(n, remaining);
                 } else {
                     size_t p = 0;
-                    while (p < chunk.size()) {
-                        utl::get_next_codepoint(chunk, p);
-                        if (cx + CELL_WIDTH > limit) {
-                            cy -= LINE_HEIGHT;
-                            cx = 25.0f;
-                        }
-                        cx += CELL_WIDTH;
+                    while (p < chunk.size() && remaining > 0) {
+                        size_t w = utl::next_cluster(chunk, p);
+                        if (w > 0)
+                            advance(static_cast<float>(w) * CELL_WIDTH);
+                        remaining -= std::min(w, remaining);
                     }
                 }
             }
         }
 
+        // Cursor moved past the end of the text.
+        for (; remaining > 0; --remaining)
+            advance(CELL_WIDTH);
+
         cursor_pos.x = cx;
         cursor_pos.y = cy;
     }
@@ -207,29 +323,106 @@ void TerminalView::render_history_mode() {
 
 void TerminalView::render_line(const ParsedLine& line, float& y_pos) {
     float x = 25.0f;
-    float limit = 25.0f + terminal.screen_cols * CELL_WIDTH;
+    for (const auto& seg : line.segments)
+        render_segment(seg.content, seg.attributes, x, y_pos);
+    y_pos -= LINE_HEIGHT;
+}
 
-    for (const auto& seg : line.segments) {
-        float fg[4], bg[4];
+void TerminalView::render_line(const LineView& line, float& y_pos, size_t from_cell) {
+    float x = 25.0f;
 
-        if (seg.attributes.reverse) {
-            get_color(seg.attributes.background, fg, true);
-            get_color(seg.attributes.foreground, bg, false);
-        } else {
-            get_color_for_attributes(seg.attributes, fg);
-            get_color(seg.attributes.background, bg, true);
+    // Rows scrolled off the top: start at the run nearest the first
+    // visible cell and drop the clusters before it unrendered.
+    size_t cell = 0;
+    bool skipping = from_cell > 0;
+    utl::GraphemeBreaker breaker;
+
+    for (auto it = line.seek(from_cell, cell); it != line.end(); ++it) {
+        // Wrapped past the bottom of the window: the rest is not shaped.
+        if (y_pos + LINE_HEIGHT < 0.0f)
+            break;
+
+        SegmentView seg = *it;
+        std::string_view content = seg.content;
+
+        if (skipping) {
+            size_t i = 0;
+            while (i < content.size()) {
+                size_t next = i;
+                size_t w = utl::next_cell(breaker, content, next);
+                if (cell >= from_cell && breaker.at_boundary()) {
+                    skipping = false;
+                    break;
+                }
+                cell += w;
+                i = next;
+            }
+            if (skipping)
+                continue;
+            content.remove_prefix(i);
         }
 
-        for (const auto& chunk : utl::split_by_devanagari(seg.content)) {
-            size_t pos = 0;
-            unsigned int cp = utl::get_next_codepoint(chunk, pos);
-            float baseline = LINE_HEIGHT * 0.25f;
+        render_segment(content, seg.attributes, x, y_pos);
+    }
+    y_pos -= LINE_HEIGHT;
+}
+
+void TerminalView::render_segment(std::string_view content,
+                                  const TerminalAttributes& attrs,
+                                  float& x, float& y_pos) {
+    float limit = 25.0f + terminal.screen_cols * CELL_WIDTH;
+    ShaderColor fg, bg;
+
+    if (attrs.reverse) {
+        fg = color_of(attrs.background, true);
+        bg = color_of(attrs.foreground, false);
+    } else {
+        fg = foreground_of(attrs);
+        bg = color_of(attrs.background, true);
+    }
 
-            if (utl::is_devanagari(cp)) {
-                float w = text_renderer->measure_text_width(chunk, 1.0f);
-                if (x + w > limit) {
+    for (const utl::ScriptRun& run : script_runs.runs(content)) {
+        // Wrapped past the bottom of the window.
+        if (y_pos + LINE_HEIGHT < 0.0f)
+            return;
+
+        std::string_view chunk = content.substr(run.begin, run.end - run.begin);
+        float baseline = BASELINE;
+
+        if (utl::needs_shaping(run.script)) {
+            float w = text_renderer->measure_text_width(chunk, 1.0f, run.script);
+            if (x + w > limit) {
+                y_pos -= LINE_HEIGHT;
+                x = 25.0f;
+            }
+
+            text_renderer->draw_solid_rectangle(
+                x, y_pos, w, LINE_HEIGHT,
+                bg, win_width, win_height);
+
+            text_renderer->render_text_harfbuzz(
+                chunk, {x, y_pos + baseline}, 1.0f,
+                fg, win_width, win_height, run.script);
+
+            x += w;
+        } else {
+            size_t p = 0;
+            while (p < chunk.size()) {
+                // A grapheme cluster, and any zero-width characters after
+                // it, share its cells; wide clusters take two.
+                size_t prev = p;
+                size_t cells = std::max<size_t>(utl::next_cluster(chunk, p), 1);
+                size_t mark = p;
+                while (mark < chunk.size() && utl::next_cluster(chunk, mark) == 0)
+                    p = mark;
+                std::string_view ch = chunk.substr(prev, p - prev);
+                float w = static_cast<float>(cells) * CELL_WIDTH;
+
+                if (x + w > limit && x > 25.0f) {
                     y_pos -= LINE_HEIGHT;
                     x = 25.0f;
+                    if (y_pos + LINE_HEIGHT < 0.0f)
+                        return;
                 }
 
                 text_renderer->draw_solid_rectangle(
@@ -237,37 +430,13 @@ void TerminalView::render_line(const ParsedLine& line, float& y_pos) {
                     bg, win_width, win_height);
 
                 text_renderer->render_text_harfbuzz(
-                    chunk, {x, y_pos + baseline}, 1.0f,
-                    fg, win_width, win_height);
+                    ch, {x, y_pos + baseline}, 1.0f,
+                    fg, win_width, win_height, run.script);
 
                 x += w;
-            } else {
-                size_t p = 0;
-                while (p < chunk.size()) {
-                    size_t prev = p;
-                    utl::get_next_codepoint(chunk, p);
-                    std::string ch = chunk.substr(prev, p - prev);
-
-                    if (x + CELL_WIDTH > limit) {
-                        y_pos -= LINE_HEIGHT;
-                        x = 25.0f;
-                    }
-
-                    text_renderer->draw_solid_rectangle(
-                        x, y_pos, CELL_WIDTH, LINE_HEIGHT,
-                        bg, win_width, win_height);
-
-                    text_renderer->render_text_harfbuzz(
-                        ch, {x, y_pos + baseline}, 1.0f,
-                        fg, win_width, win_height);
-
-                    x += CELL_WIDTH;
-                }
             }
         }
     }
-
-    y_pos -= LINE_HEIGHT;
 }
 
 // ------------------------------------------------------------
@@ -275,7 +444,7 @@ void TerminalView::render_line(const ParsedLine& line, float& y_pos) {
 // ------------------------------------------------------------
 
 void TerminalView::render_cursor(float x, float y) {
-    float color[4] = {1.f, 1.f, 1.f, 1.f};
+    ShaderColor color = ShaderColor::palette(Palette::FOREGROUND);
     text_renderer->draw_solid_rectangle(
         x, y, CELL_WIDTH, LINE_HEIGHT,
         color, win_width, win_height);
@@ -287,17 +456,17 @@ void TerminalView::render_preedit(float x, float y) {
         return;
 
     float cx = x;
-    float baseline = LINE_HEIGHT * 0.25f;
+    float baseline = BASELINE;
 
-    float fg[4] = {1.f, 1.f, 1.f, 1.f};
-    float bg[4] = {0.2f, 0.2f, 0.2f, 1.f};
+    ShaderColor fg = ShaderColor::rgb(1.f, 1.f, 1.f);
+    ShaderColor bg = ShaderColor::rgb(0.2f, 0.2f, 0.2f);
 
-    for (const auto& chunk : utl::split_by_devanagari(pre)) {
-        size_t pos = 0;
-        unsigned int cp = utl::get_next_codepoint(chunk, pos);
+    std::string_view text = pre;
+    for (const utl::ScriptRun& run : script_runs.runs(text)) {
+        std::string_view chunk = text.substr(run.begin, run.end - run.begin);
 
-        if (utl::is_devanagari(cp)) {
-            float w = text_renderer->measure_text_width(chunk, 1.0f);
+        if (utl::needs_shaping(run.script)) {
+            float w = text_renderer->measure_text_width(chunk, 1.0f, run.script);
 
             text_renderer->draw_solid_rectangle(
                 cx, y, w, LINE_HEIGHT,
@@ -305,7 +474,7 @@ void TerminalView::render_preedit(float x, float y) {
 
             text_renderer->render_text_harfbuzz(
                 chunk, {cx, y + baseline}, 1.0f,
-                fg, win_width, win_height);
+                fg, win_width, win_height, run.script);
 
             float underline_y = y + baseline - 2.0f;
             text_renderer->draw_solid_rectangle(
@@ -318,7 +487,7 @@ void TerminalView::render_preedit(float x, float y) {
             while (p < chunk.size()) {
                 size_t prev = p;
                 utl::get_next_codepoint(chunk, p);
-                std::string ch = chunk.substr(prev, p - prev);
+                std::string_view ch = chunk.substr(prev, p - prev);
 
                 text_renderer->draw_solid_rectangle(
                     cx, y, CELL_WIDTH, LINE_HEIGHT,
@@ -326,7 +495,7 @@ void TerminalView::render_preedit(float x, float y) {
 
                 text_renderer->render_text_harfbuzz(
                     ch, {cx, y + baseline}, 1.0f,
-                    fg, win_width, win_height);
+                    fg, win_width, win_height, run.script);
 
                 float underline_y = y + baseline - 2.0f;
                 text_renderer->draw_solid_rectangle(
@@ -340,83 +509,31 @@ void TerminalView::render_preedit(float x, float y) {
 }
 
 
-void TerminalView::get_color(const TerminalColor &color,
-                             float *out_color,
-                             bool is_bg)
+ShaderColor TerminalView::color_of(const TerminalColor &color, bool is_bg)
 {
-    if (color.type == TerminalColor::Type::RGB) {
-        out_color[0] = color.r / 255.0f;
-        out_color[1] = color.g / 255.0f;
-        out_color[2] = color.b / 255.0f;
-        out_color[3] = 1.0f;
-        return;
-    }
-
-    if (color.type == TerminalColor::Type::INDEXED) {
-        // Simple fallback
-        if (is_bg) {
-            out_color[0] = 0.0f;
-            out_color[1] = 0.0f;
-            out_color[2] = 0.0f;
-            out_color[3] = 1.0f;
-        } else {
-            out_color[0] = 1.0f;
-            out_color[1] = 1.0f;
-            out_color[2] = 1.0f;
-            out_color[3] = 1.0f;
-        }
-        return;
-    }
-
-    if (color.type == TerminalColor::Type::ANSI) {
-        switch (color.ansi_color) {
-        case AnsiColor::BLACK:         out_color[0]=0.0f; out_color[1]=0.0f; out_color[2]=0.0f; break;
-        case AnsiColor::RED:           out_color[0]=0.8f; out_color[1]=0.0f; out_color[2]=0.0f; break;
-        case AnsiColor::GREEN:         out_color[0]=0.0f; out_color[1]=0.8f; out_color[2]=0.0f; break;
-        case AnsiColor::YELLOW:        out_color[0]=0.8f; out_color[1]=0.8f; out_color[2]=0.0f; break;
-        case AnsiColor::BLUE:          out_color[0]=0.0f; out_color[1]=0.0f; out_color[2]=0.8f; break;
-        case AnsiColor::MAGENTA:       out_color[0]=0.8f; out_color[1]=0.0f; out_color[2]=0.8f; break;
-        case AnsiColor::CYAN:          out_color[0]=0.0f; out_color[1]=0.8f; out_color[2]=0.8f; break;
-        case AnsiColor::WHITE:         out_color[0]=0.9f; out_color[1]=0.9f; out_color[2]=0.9f; break;
-        case AnsiColor::BRIGHT_BLACK:  out_color[0]=0.5f; out_color[1]=0.5f; out_color[2]=0.5f; break;
-        case AnsiColor::BRIGHT_RED:    out_color[0]=1.0f; out_color[1]=0.0f; out_color[2]=0.0f; break;
-        case AnsiColor::BRIGHT_GREEN:  out_color[0]=0.0f; out_color[1]=1.0f; out_color[2]=0.0f; break;
-        case AnsiColor::BRIGHT_YELLOW: out_color[0]=1.0f; out_color[1]=1.0f; out_color[2]=0.0f; break;
-        case AnsiColor::BRIGHT_BLUE:   out_color[0]=0.0f; out_color[1]=0.0f; out_color[2]=1.0f; break;
-        case AnsiColor::BRIGHT_MAGENTA:out_color[0]=1.0f; out_color[1]=0.0f; out_color[2]=1.0f; break;
-        case AnsiColor::BRIGHT_CYAN:   out_color[0]=0.0f; out_color[1]=1.0f; out_color[2]=1.0f; break;
-        case AnsiColor::BRIGHT_WHITE:  out_color[0]=1.0f; out_color[1]=1.0f; out_color[2]=1.0f; break;
-        default:                       out_color[0]=1.0f; out_color[1]=1.0f; out_color[2]=1.0f; break;
-        }
-        out_color[3] = 1.0f;
-        return;
-    }
-
-    // DEFAULT
-    if (is_bg) {
-        out_color[0] = 0.0f;
-        out_color[1] = 0.0f;
-        out_color[2] = 0.0f;
-        out_color[3] = 1.0f;
-    } else {
-        out_color[0] = 1.0f;
-        out_color[1] = 1.0f;
-        out_color[2] = 1.0f;
-        out_color[3] = 1.0f;
+    switch (color.type) {
+    case TerminalColor::Type::RGB:
+        return ShaderColor::rgb(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f);
+    case TerminalColor::Type::INDEXED:
+        return ShaderColor::palette(std::clamp(color.indexed_color, 0, Palette::COLORS - 1));
+    case TerminalColor::Type::ANSI:
+        if (color.ansi_color != AnsiColor::RESET)
+            return ShaderColor::palette(static_cast<int>(color.ansi_color));
+        break;
+    case TerminalColor::Type::DEFAULT:
+        break;
     }
+    return ShaderColor::palette(is_bg ? Palette::BACKGROUND : Palette::FOREGROUND);
 }
 
-void TerminalView::get_color_for_attributes(const TerminalAttributes& attrs,
-                                            float* color)
+// Bold makes the eight basic colours bright, as in xterm.
+ShaderColor TerminalView::foreground_of(const TerminalAttributes& attrs)
 {
-    get_color(attrs.foreground, color, false);
-
+    ShaderColor color = color_of(attrs.foreground, false);
     if (attrs.bold &&
         attrs.foreground.type == TerminalColor::Type::ANSI &&
         attrs.foreground.ansi_color < AnsiColor::BRIGHT_BLACK)
-    {
-        for (int i = 0; i < 3; ++i)
-            color[i] = std::min(1.0f, color[i] + 0.5f);
-    }
+        color.slot += 8;
+    return color;
 }
 
@@ -1,13 +1,19 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <format>
-#include <fstream>
 #include <iostream>
 #include <print>
+#include <utility>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "grapheme.h"
 #include "oglutil.h"
+#include "text.frag.h"
+#include "text.vert.h"
 #include "text_renderer.h"
 #include "utils.h"
 
@@ -32,46 +38,54 @@ template <> struct std::formatter<Character> : std::formatter<std::string> {
   }
 };
 
+namespace {
+
+void append_utf8(std::string &out, char32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+} // namespace
+
 std::string show_char(Character c) {
   return std::format(
       "Width: {}, height: {}, bearing_x: {}, bearing_y: {} advance: {}",
       c.width, c.height, c.bearing_x, c.bearing_y, c.advance);
 }
-TextRenderer::TextRenderer()
-    : main_font("/home/pranphy/.local/share/fonts/iosevka/IosevkaTermSlabNerdFont-Regular.ttf"),
-      fallback_font("/home/pranphy/.local/share/fonts/devanagari/NotoSerif/"
-                    "NotoSerifDevanagari-Regular.ttf") {
-
-  // Initialize shader - look for files in current directory (build directory)
-  // Initialize shader - try multiple paths
-  std::string vertPath = "text.vert";
-  std::string fragPath = "text.frag";
-
-  // Check if files exist, if not try ../shaders/
-  std::ifstream f(vertPath);
-  if (!f.good()) {
-    vertPath = "../shaders/text.vert";
-    fragPath = "../shaders/text.frag";
-    std::ifstream f2(vertPath);
-    if (!f2.good()) {
-      vertPath = "shaders/text.vert";
-      fragPath = "shaders/text.frag";
-    }
-  }
+TextRenderer::TextRenderer(std::vector<std::string> fonts, bool sdf)
+    : sdf(sdf), atlas(std::make_unique<GlyphAtlas>()),
+      rasterizer(std::make_unique<GlyphRasterizer>(sdf)),
+      fallback(std::move(fonts),
+               [this](size_t index, const std::string &path, long face_index) {
+                 return load_font(path.c_str(), index, face_index);
+               }) {
+  // Initialize HarfBuzz
+  hb_buffer = hb_buffer_create();
 
-  std::println("Loading shaders from: {} and {}", vertPath, fragPath);
-  shader = new Shader(vertPath.c_str(), fragPath.c_str());
+  // Open the main font now for its metrics; fallbacks wait for a
+  // character that needs them.
+  fallback.font_for(U'M');
+}
+
+void TextRenderer::init_gl() {
+  // Shader sources are embedded at build time
+  shader = new Shader(text_vert, text_frag);
+  shader->use();
+  shader->set_int("palette", 1);   // texture unit
 
   // Setup buffers
   setup_buffers();
 
-  // Initialize HarfBuzz
-  hb_buffer = hb_buffer_create();
-
-  // Load primary font (index 0)
-  load_font(main_font, 0);
-
-  load_font(fallback_font, 1);
+  glPixelStorei(GL_UNPACK_ALIGNMENT,
+                1); // Disable byte-alignment restriction this is !important
 
   // Create white texture for solid rectangles
   glGenTextures(1, &white_texture);
@@ -86,9 +100,14 @@ TextRenderer::TextRenderer()
 }
 
 TextRenderer::~TextRenderer() {
-  delete shader;
-  glDeleteVertexArrays(1, &vao);
-  glDeleteBuffers(1, &vbo);
+  if (shader) {
+    delete shader;
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteTextures(1, &white_texture);
+    if (palette_texture)
+      glDeleteTextures(1, &palette_texture);
+  }
 
   // Cleanup HarfBuzz
   if (hb_buffer)
@@ -97,6 +116,45 @@ TextRenderer::~TextRenderer() {
     if (hb_font)
       hb_font_destroy(hb_font);
   }
+  for (FT_Face face : ft_faces)
+    if (face)
+      FT_Done_Face(face);
+}
+
+void TextRenderer::set_palette(const uint8_t *rgb, int count) {
+  if (!palette_texture) {
+    glGenTextures(1, &palette_texture);
+    glBindTexture(GL_TEXTURE_2D, palette_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, palette_texture);
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (count == palette_size) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, count, 1, GL_RGB, GL_UNSIGNED_BYTE,
+                    rgb);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, count, 1, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, rgb);
+    palette_size = count;
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Expects the shader in use; leaves texture unit 0 active.
+void TextRenderer::set_color(const ShaderColor &color) {
+  bool indexed = color.slot >= 0 && color.slot < palette_size;
+  shader->set_int("paletteSlot", indexed ? color.slot : -1);
+  shader->set_vec3("textColor", color.r, color.g, color.b);
+  if (indexed) {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, palette_texture);
+  }
+  glActiveTexture(GL_TEXTURE0);
 }
 
 void TextRenderer::setup_buffers() {
@@ -111,169 +169,308 @@ void TextRenderer::setup_buffers() {
   glBindVertexArray(0);
 }
 
-void TextRenderer::load_font(const char *font_path, unsigned int font_index) {
-  FT_Library ft;
-  if (FT_Init_FreeType(&ft)) {
-    std::println(std::cerr, "ERROR::FREETYPE: Could not init FreeType Library");
-    return;
+FT_Face TextRenderer::load_font(const char *font_path, unsigned int font_index,
+                                long face_index) {
+  std::shared_ptr<const FontFile> file = FontFile::open(font_path);
+  FT_Face face = file ? file->new_face(shared_ft_library(), face_index) : nullptr;
+  if (!face) {
+    std::println(std::cerr, "ERROR::FREETYPE: Failed to load font {}", font_path);
+    return nullptr;
   }
 
-  FT_Face face;
-  if (FT_New_Face(ft, font_path, 0, &face)) {
-    std::println(std::cerr, "ERROR::FREETYPE: Failed to load font");
-    return;
-  }
-
-  FT_Set_Pixel_Sizes(face, 0, 38); // Set font size
-
-  // Initialize HarfBuzz font
-  hb_font_t *hb_font = hb_ft_font_create(face, nullptr);
+  FT_Set_Pixel_Sizes(face, 0, pixel_size); // Set font size
+
+  // Initialize HarfBuzz font on the same memory; the blob keeps the
+  // mapping alive for as long as HarfBuzz holds it.
+  hb_blob_t *blob = hb_blob_create(
+      reinterpret_cast<const char *>(file->data()),
+      static_cast<unsigned int>(file->size()), HB_MEMORY_MODE_READONLY,
+      new std::shared_ptr<const FontFile>(file), [](void *user_data) {
+        delete static_cast<std::shared_ptr<const FontFile> *>(user_data);
+      });
+  hb_face_t *hb_face = hb_face_create(blob, static_cast<unsigned int>(face_index));
+  hb_blob_destroy(blob);
+  hb_font_t *hb_font = hb_font_create(hb_face);
+  hb_face_destroy(hb_face);
   if (!hb_font) {
     std::println(std::cerr, "ERROR::HARFBUZZ: Failed to create HarfBuzz font");
-    return;
+    FT_Done_Face(face);
+    return nullptr;
   }
+  hb_ot_font_set_funcs(hb_font);
+  set_hb_scale(hb_font);
 
   // Store the face and font
   if (font_index >= ft_faces.size()) {
     ft_faces.resize(font_index + 1);
     hb_fonts.resize(font_index + 1);
-    font_glyphs.resize(font_index + 1);
+    font_sources.resize(font_index + 1);
   }
   ft_faces[font_index] = face;
   hb_fonts[font_index] = hb_font;
+  font_sources[font_index] = {file, face_index};
+  rasterizer->add_font(font_index, file, face_index, atlas_size);
+  if (next_rasterizer)
+    next_rasterizer->add_font(font_index, file, face_index, pixel_size);
 
-  glPixelStorei(GL_UNPACK_ALIGNMENT,
-                1); // Disable byte-alignment restriction this is !important
+  return face;
+}
 
-  // Note: Don't destroy ft_face here as HarfBuzz needs it
-  // FT_Done_Face(face);
-  // FT_Done_FreeType(ft);
+// Font units to 26.6 pixels at the current size, as FreeType scales them.
+void TextRenderer::set_hb_scale(hb_font_t *font) {
+  int scale = static_cast<int>(pixel_size) * 64;
+  hb_font_set_scale(font, scale, scale);
+  hb_font_set_ppem(font, pixel_size, pixel_size);
 }
 
-unsigned int TextRenderer::get_glyph_id_for_char(char c,
-                                                 unsigned int font_index) {
-  if (font_index < ft_faces.size() && ft_faces[font_index]) {
-    return FT_Get_Char_Index(ft_faces[font_index], c);
-  }
-  return 0;
+// A glyph not in the atlas yet is queued for the workers; it is drawn from
+// the frame after it arrives.
+const Character *TextRenderer::glyph(unsigned int glyph_id,
+                                     unsigned int font_index) {
+  if (const Character *ch = atlas->find(font_index, glyph_id))
+    return ch;
+  rasterizer->request(font_index, glyph_id);
+  return nullptr;
 }
 
-void TextRenderer::load_glyph(unsigned int glyph_id, unsigned int font_index) {
-  // Load the glyph using FreeType
-  if (FT_Load_Glyph(ft_faces[font_index], glyph_id, FT_LOAD_RENDER)) {
-    std::println(std::cerr,
-                 "ERROR::FREETYPE: Failed to load Glyph {} for font index {}",
-                 glyph_id, font_index);
-    return;
+void TextRenderer::next_frame() {
+  atlas->next_frame();
+  if (prewarming) {
+    rasterizer->drain(rasterized);
+    prewarming = false;
+  } else {
+    rasterizer->collect(rasterized);
   }
-
-  // Debug log for empty glyphs
-  if (ft_faces[font_index]->glyph->bitmap.width == 0 ||
-      ft_faces[font_index]->glyph->bitmap.rows == 0) {
-    // std::println("Warning: Empty bitmap for glyph {}", glyph_id);
+  if (!rasterized.empty()) {
+    atlas->insert(rasterized);
+    rasterized.clear();
   }
 
-  // Generate texture
-  unsigned int texture;
-  oglutil::load_glyph_to_texture(ft_faces[font_index]->glyph, texture);
-
-  // Store character information
-  Character character = {
-      texture,
-      static_cast<int>(ft_faces[font_index]->glyph->bitmap.width),
-      static_cast<int>(ft_faces[font_index]->glyph->bitmap.rows),
-      ft_faces[font_index]->glyph->bitmap_left,
-      ft_faces[font_index]->glyph->bitmap_top,
-      static_cast<unsigned int>(ft_faces[font_index]->glyph->advance.x >> 6)
-
-  };
-
-  font_glyphs[font_index][glyph_id] = character;
+  if (!next_rasterizer)
+    return;
+  next_atlas->next_frame();
+  next_rasterizer->collect(rasterized);
+  if (!rasterized.empty()) {
+    next_atlas->insert(rasterized);
+    rasterized.clear();
+  }
+  if (!next_rasterizer->busy()) {
+    atlas = std::move(next_atlas);
+    retire(std::exchange(rasterizer, std::move(next_rasterizer)));
+    atlas_size = pixel_size;
+  }
 }
 
-std::vector<ShapedGlyph> TextRenderer::shape_text(const std::string &text) {
-  std::vector<ShapedGlyph> shaped_glyphs;
+void TextRenderer::retire(std::unique_ptr<GlyphRasterizer> old) {
+  std::erase_if(retiring, [](const std::future<void> &done) {
+    return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  });
+  retiring.push_back(std::async(std::launch::async,
+                                [old = std::move(old)]() mutable { old.reset(); }));
+}
 
-  // Reset buffer
-  hb_buffer_reset(hb_buffer);
+void TextRenderer::set_glyph_budget(size_t bytes) {
+  glyph_budget = bytes;
+  atlas->set_budget(bytes);
+  if (next_atlas)
+    next_atlas->set_budget(bytes);
+}
 
-  // Add text to buffer
-  hb_buffer_add_utf8(hb_buffer, text.c_str(), -1, 0, -1);
+void TextRenderer::set_pixel_size(unsigned int size) {
+  size = std::clamp(size, MIN_PIXEL_SIZE, MAX_PIXEL_SIZE);
+  if (size == pixel_size)
+    return;
+  pixel_size = size;
 
-  // Determine script and font based on content
-  // We check the first character to decide (assuming the input chunk is
-  // homogeneous as per split_by_devanagari)
-  bool is_deva = false;
-  size_t pos = 0;
-  if (!text.empty()) {
-    unsigned int first_cp = utl::get_next_codepoint(text, pos);
-    is_deva = utl::is_devanagari(first_cp);
+  for (size_t i = 0; i < ft_faces.size(); ++i) {
+    if (!ft_faces[i])
+      continue;
+    FT_Set_Pixel_Sizes(ft_faces[i], 0, pixel_size);
+    set_hb_scale(hb_fonts[i]);
   }
 
-  if (is_deva) {
-    hb_buffer_set_script(hb_buffer, HB_SCRIPT_DEVANAGARI);
-    hb_buffer_set_language(hb_buffer, hb_language_from_string("hi", -1));
-  } else {
-    // For non-Devanagari, let HarfBuzz guess the script and direction
-    hb_buffer_guess_segment_properties(hb_buffer);
+  // A rebuild for an earlier step is dropped; glyphs it finished are lost,
+  // and not saved, as it covers only part of what the atlas holds
+  if (next_rasterizer) {
+    next_rasterizer->cancel();
+    retire(std::move(next_rasterizer));
   }
+  next_atlas.reset();
+  if (sdf || pixel_size == atlas_size)
+    return;
 
-  // Set direction to LTR (Devanagari is LTR)
-  hb_buffer_set_direction(hb_buffer, HB_DIRECTION_LTR);
+  // Render everything the current atlas holds again at the new size
+  next_atlas = std::make_unique<GlyphAtlas>();
+  next_atlas->set_budget(glyph_budget);
+  next_rasterizer = std::make_unique<GlyphRasterizer>(sdf);
+  for (size_t i = 0; i < font_sources.size(); ++i)
+    if (font_sources[i].file)
+      next_rasterizer->add_font(i, font_sources[i].file,
+                                font_sources[i].face_index, pixel_size);
+  for (auto [font_index, glyph_id] : atlas->glyphs())
+    next_rasterizer->request(font_index, glyph_id);
+}
 
-  // Select font: 0 for Latin (Main), 1 for Devanagari (Fallback)
-  unsigned int font_index = is_deva ? 1 : 0;
+void TextRenderer::prewarm(std::string_view devanagari) {
+  std::string common;
+  for (char c = 0x20; c < 0x7F; ++c)
+    common += c;
+  // Box drawing and block elements, for TUIs
+  for (char32_t cp = 0x2500; cp <= 0x259F; ++cp)
+    append_utf8(common, cp);
+
+  // glyph() queues whatever the atlas does not have
+  for (const ShapedGlyph &g : shape_text(common, utl::Script::Common))
+    glyph(g.glyph_id, g.font_index);
+  for (const ShapedGlyph &g : shape_text(devanagari, utl::Script::Devanagari))
+    glyph(g.glyph_id, g.font_index);
+  prewarming = true;
+}
+
+std::string TextRenderer::common_devanagari() {
+  std::string clusters;
+  auto add = [&clusters](std::initializer_list<char32_t> cps) {
+    for (char32_t cp : cps)
+      append_utf8(clusters, cp);
+    clusters += ' ';
+  };
 
-  // Ensure we have the font loaded
-  if (font_index >= hb_fonts.size() || !hb_fonts[font_index]) {
-    // Fallback to main font if specific font not available
-    font_index = 0;
+  for (char32_t vowel = 0x0905; vowel <= 0x0914; ++vowel)   // अ .. औ
+    add({vowel});
+  for (char32_t digit = 0x0966; digit <= 0x096F; ++digit)   // ० .. ९
+    add({digit});
+
+  // Vowel signs ा .. ौ, then anusvara, chandrabindu, visarga and virama
+  std::vector<char32_t> signs;
+  for (char32_t sign = 0x093E; sign <= 0x094C; ++sign)
+    signs.push_back(sign);
+  signs.insert(signs.end(), {0x0902, 0x0901, 0x0903, 0x094D});
+
+  for (char32_t consonant = 0x0915; consonant <= 0x0939; ++consonant) {
+    add({consonant});
+    for (char32_t sign : signs)
+      add({consonant, sign});
   }
 
-  hb_font_t *current_hb_font = hb_fonts[font_index];
+  // क्ष त्र ज्ञ श्र द्ध द्व स्त न्त प्र क्र र्म
+  add({0x0915, 0x094D, 0x0937});
+  add({0x0924, 0x094D, 0x0930});
+  add({0x091C, 0x094D, 0x091E});
+  add({0x0936, 0x094D, 0x0930});
+  add({0x0926, 0x094D, 0x0927});
+  add({0x0926, 0x094D, 0x0935});
+  add({0x0938, 0x094D, 0x0924});
+  add({0x0928, 0x094D, 0x0924});
+  add({0x092A, 0x094D, 0x0930});
+  add({0x0915, 0x094D, 0x0930});
+  add({0x0930, 0x094D, 0x092E});
+  return clusters;
+}
 
-  // Shape the text
-  hb_shape(current_hb_font, hb_buffer, nullptr, 0);
+void TextRenderer::set_hb_buffer_properties(hb_buffer_t *buf,
+                                            utl::Script script) {
+  if (script == utl::Script::Common || script == utl::Script::Inherited) {
+    // No script known: let HarfBuzz guess, but keep cell order LTR
+    hb_buffer_guess_segment_properties(buf);
+    hb_buffer_set_direction(buf, HB_DIRECTION_LTR);
+  } else {
+    // The itemizer split runs by script; RTL runs come back in visual order
+    hb_script_t hb_script = hb_script_from_string(utl::script_tag(script), 4);
+    hb_buffer_set_script(buf, hb_script);
+    hb_buffer_set_direction(buf, hb_script_get_horizontal_direction(hb_script));
+    if (script == utl::Script::Devanagari)
+      hb_buffer_set_language(buf, hb_language_from_string("hi", -1));
+    else
+      hb_buffer_guess_segment_properties(buf);
+  }
+}
 
-  // Get shaped glyph information
+// Each cluster goes to the font that has its first character, so marks and
+// joiners stay with their base even if another font also has them.
+void TextRenderer::split_by_font(std::string_view text) {
+  font_spans.clear();
+  utl::GraphemeBreaker breaker;
+
+  for (size_t i = 0; i < text.size();) {
+    size_t at = i;
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    char32_t cp = c < 0x80 ? (++i, c) : utl::get_next_codepoint(text, i);
+    if (!breaker.next(cp))
+      continue;
+
+    size_t font_index = fallback.font_for(cp);
+    if (!font_spans.empty() && font_spans.back().font_index == font_index)
+      continue;
+    if (!font_spans.empty())
+      font_spans.back().end = at;
+    font_spans.push_back({at, text.size(), font_index});
+  }
+}
+
+void TextRenderer::append_shaped_glyphs(hb_buffer_t *buf, size_t font_index,
+                                        std::vector<ShapedGlyph> &out) {
   unsigned int glyph_count;
-  hb_glyph_info_t *glyph_info =
-      hb_buffer_get_glyph_infos(hb_buffer, &glyph_count);
+  hb_glyph_info_t *glyph_info = hb_buffer_get_glyph_infos(buf, &glyph_count);
   hb_glyph_position_t *glyph_pos =
-      hb_buffer_get_glyph_positions(hb_buffer, &glyph_count);
+      hb_buffer_get_glyph_positions(buf, &glyph_count);
 
   for (unsigned int i = 0; i < glyph_count; i++) {
     ShapedGlyph shaped_glyph;
     shaped_glyph.glyph_id = glyph_info[i].codepoint;
     shaped_glyph.x_offset = glyph_pos[i].x_offset / 64.0f;
     shaped_glyph.y_offset = glyph_pos[i].y_offset / 64.0f;
-    shaped_glyph.x_advance = glyph_pos[i].x_advance / 64.0f;
-    shaped_glyph.y_advance = glyph_pos[i].y_advance / 64.0f;
-    shaped_glyph.font_index = font_index;
-
-    // Load glyph if not already loaded for this font
-    if (font_glyphs[font_index].find(shaped_glyph.glyph_id) ==
-        font_glyphs[font_index].end()) {
-      load_glyph(shaped_glyph.glyph_id, font_index);
-    }
+    // Whole pixels, as FreeType's hinted advances were, so cells stay on
+    // the pixel grid
+    shaped_glyph.x_advance = std::round(glyph_pos[i].x_advance / 64.0f);
+    shaped_glyph.y_advance = std::round(glyph_pos[i].y_advance / 64.0f);
+    shaped_glyph.font_index = static_cast<int>(font_index);
+    out.push_back(shaped_glyph);
+  }
+}
 
-    shaped_glyph.character = &font_glyphs[font_index][shaped_glyph.glyph_id];
-    shaped_glyphs.push_back(shaped_glyph);
+std::vector<ShapedGlyph> TextRenderer::shape_text(std::string_view text,
+                                                  utl::Script script) {
+  std::vector<ShapedGlyph> shaped_glyphs;
+  split_by_font(text);
+
+  // Spans are shaped separately, each with the whole run as context so
+  // joining and reordering see across the font change.
+  std::vector<ShapedGlyph> span_glyphs;
+  for (const FontSpan &span : font_spans) {
+    if (span.font_index >= hb_fonts.size() || !hb_fonts[span.font_index])
+      continue;
+
+    hb_buffer_reset(hb_buffer);
+    hb_buffer_add_utf8(hb_buffer, text.data(), static_cast<int>(text.size()),
+                       static_cast<unsigned int>(span.begin),
+                       static_cast<int>(span.end - span.begin));
+    set_hb_buffer_properties(hb_buffer, script);
+    bool backward = HB_DIRECTION_IS_BACKWARD(hb_buffer_get_direction(hb_buffer));
+
+    hb_shape(hb_fonts[span.font_index], hb_buffer, nullptr, 0);
+
+    span_glyphs.clear();
+    append_shaped_glyphs(hb_buffer, span.font_index, span_glyphs);
+    // Right-to-left spans come out in visual order; the first one goes last
+    shaped_glyphs.insert(backward ? shaped_glyphs.begin() : shaped_glyphs.end(),
+                         span_glyphs.begin(), span_glyphs.end());
   }
 
   return shaped_glyphs;
 }
 
-Coord TextRenderer::render_text_harfbuzz(const std::string &text, Coord cur_pos,
-                                         float scale, const float *color,
-                                         int window_width, int window_height) {
+Coord TextRenderer::render_text_harfbuzz(std::string_view text, Coord cur_pos,
+                                         float scale, const ShaderColor &color,
+                                         int window_width, int window_height,
+                                         utl::Script script) {
   // Enable blending
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // Activate shader
   shader->use();
-  shader->set_vec3("textColor", color[0], color[1], color[2]);
+  set_color(color);
+  shader->set_bool("sdf", sdf);
 
   // Create orthographic projection matrix using window dimensions
   glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(window_width),
@@ -284,21 +481,27 @@ Coord TextRenderer::render_text_harfbuzz(const std::string &text, Coord cur_pos,
   glBindVertexArray(vao);
 
   // Shape the text using HarfBuzz
-  std::vector<ShapedGlyph> shaped_glyphs = shape_text(text);
+  std::vector<ShapedGlyph> shaped_glyphs = shape_text(text, script);
+  // Glyphs still from before a size change are stretched to the new size
+  float glyph_scale = scale * static_cast<float>(pixel_size) / atlas_size;
 
   for (const ShapedGlyph &shaped_glyph : shaped_glyphs) {
-    Character *ch = shaped_glyph.character;
+    const Character *ch = glyph(shaped_glyph.glyph_id, shaped_glyph.font_index);
 
-    // Calculate position with HarfBuzz offsets
-    float xpos = cur_pos.x + (ch->bearing_x + shaped_glyph.x_offset) * scale;
-    float ypos = cur_pos.y -
-                 (ch->height - ch->bearing_y - shaped_glyph.y_offset) * scale;
+    if (ch && ch->texture_id) {
+      // Calculate position with HarfBuzz offsets
+      float xpos = cur_pos.x + ch->bearing_x * glyph_scale +
+                   shaped_glyph.x_offset * scale;
+      float ypos = cur_pos.y - (ch->height - ch->bearing_y) * glyph_scale +
+                   shaped_glyph.y_offset * scale;
 
-    float w = ch->width * scale;
-    float h = ch->height * scale;
+      float w = ch->width * glyph_scale;
+      float h = ch->height * glyph_scale;
 
-    oglutil::render_texture_over_rectangle(ch->texture_id, vbo, xpos, ypos, w,
-                                           h);
+      oglutil::render_texture_over_rectangle(ch->texture_id, vbo, xpos, ypos,
+                                             w, h, ch->u0, ch->v0, ch->u1,
+                                             ch->v1);
+    }
 
     // Advance cursor using HarfBuzz advances
     cur_pos.x += shaped_glyph.x_advance * scale;
@@ -310,8 +513,9 @@ Coord TextRenderer::render_text_harfbuzz(const std::string &text, Coord cur_pos,
   return cur_pos;
 }
 
-float TextRenderer::measure_text_width(const std::string &text, float scale) {
-  std::vector<ShapedGlyph> shaped_glyphs = shape_text(text);
+float TextRenderer::measure_text_width(std::string_view text, float scale,
+                                       utl::Script script) {
+  std::vector<ShapedGlyph> shaped_glyphs = shape_text(text, script);
   float width = 0.0f;
   for (const ShapedGlyph &shaped_glyph : shaped_glyphs) {
     width += shaped_glyph.x_advance * scale;
@@ -325,12 +529,25 @@ float TextRenderer::get_char_width() {
 }
 
 float TextRenderer::get_line_height() {
-  // Return font size + padding (e.g. 50.0f for 48px font)
-  return 50.0f;
+  // The primary font's own line spacing at the current size
+  if (ft_faces.empty() || !ft_faces[0] || !ft_faces[0]->size)
+    return std::ceil(pixel_size * 1.3f);
+  return std::ceil(ft_faces[0]->size->metrics.height / 64.0f);
+}
+
+float TextRenderer::get_baseline() {
+  if (ft_faces.empty() || !ft_faces[0] || !ft_faces[0]->size)
+    return get_line_height() * 0.25f;
+  const FT_Size_Metrics &metrics = ft_faces[0]->size->metrics;
+  float ascender = metrics.ascender / 64.0f;
+  float descender = -metrics.descender / 64.0f;
+  // Leading beyond ascender and descender is split above and below
+  float leading = std::max(get_line_height() - ascender - descender, 0.0f);
+  return std::round(descender + leading / 2);
 }
 
 void TextRenderer::draw_solid_rectangle(float x, float y, float w, float h,
-                                        const float *color, int window_width,
+                                        const ShaderColor &color, int window_width,
                                         int window_height) {
   // Enable blending
   glEnable(GL_BLEND);
@@ -338,7 +555,8 @@ void TextRenderer::draw_solid_rectangle(float x, float y, float w, float h,
 
   // Activate shader
   shader->use();
-  shader->set_vec3("textColor", color[0], color[1], color[2]);
+  set_color(color);
+  shader->set_bool("sdf", false);
 
   // Create orthographic projection matrix using window dimensions
   glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(window_width),
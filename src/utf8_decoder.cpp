@@ -0,0 +1,37 @@
+#include "utf8_decoder.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace utl {
+
+// A byte is ASCII when its top bit is clear: test 16 bytes per step with
+// SSE2, or 8 as a machine word elsewhere, then finish bytewise.
+size_t ascii_prefix(const char *p, size_t n) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    int mask = _mm_movemask_epi8(block);
+    if (mask != 0)
+      return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+  }
+#else
+  for (; i + 8 <= n; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, p + i, sizeof word);
+    if (word & 0x8080808080808080ull)
+      break;
+  }
+#endif
+
+  while (i < n && static_cast<unsigned char>(p[i]) < 0x80)
+    ++i;
+  return i;
+}
+
+} // namespace utl
@@ -1,25 +1,14 @@
+#include <cstdlib>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "utils.h"
 
 namespace utl {
 
-// Function to check if a Unicode code point is Devanagari or ZWJ/ZWNJ
-bool is_devanagari(unsigned int codepoint) {
-  // Check for Devanagari Unicode block
-  if (codepoint >= 0x0900 && codepoint <= 0x097F) {
-    return true;
-  }
-  // Check for ZWJ and ZWNJ
-  if (codepoint == 0x200D || codepoint == 0x200C) {
-    return true;
-  }
-  return false;
-}
-
 // Simple UTF-8 decoder to get the next code point
-unsigned int get_next_codepoint(const std::string &s, size_t &pos) {
+unsigned int get_next_codepoint(std::string_view s, size_t &pos) {
   if (pos >= s.length()) {
     return 0;
   }
@@ -62,39 +51,6 @@ unsigned int get_next_codepoint(const std::string &s, size_t &pos) {
   return codepoint;
 }
 
-std::vector<std::string> split_by_devanagari(const std::string &input) {
-  std::vector<std::string> result;
-  if (input.empty()) {
-    return result;
-  }
-
-  size_t pos = 0;
-  size_t start_of_group = 0;
-  unsigned int first_codepoint = get_next_codepoint(input, pos);
-  bool in_devanagari_group = is_devanagari(first_codepoint);
-  pos = 0; // Reset position for full iteration
-
-  while (pos < input.length()) {
-    size_t current_char_start_pos = pos;
-    unsigned int codepoint = get_next_codepoint(input, pos);
-
-    bool current_is_devanagari = is_devanagari(codepoint);
-
-    if (current_is_devanagari != in_devanagari_group) {
-      result.push_back(input.substr(start_of_group,
-                                    current_char_start_pos - start_of_group));
-      start_of_group = current_char_start_pos;
-      in_devanagari_group = current_is_devanagari;
-    }
-  }
-
-  if (start_of_group < input.length()) {
-    result.push_back(input.substr(start_of_group));
-  }
-
-  return result;
-}
-
 } // namespace utl
 std::vector<std::string> utl::split_by_newline(const std::string &input) {
   std::vector<std::string> result;
@@ -131,3 +87,11 @@ std::vector<std::string> utl::split_by_space(const std::string &input) {
   }
   return result;
 }
+
+std::string utl::cache_dir() {
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+    return std::string(xdg) + "/sita";
+  if (const char *home = std::getenv("HOME"); home && *home)
+    return std::string(home) + "/.cache/sita";
+  return {};
+}
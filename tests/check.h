@@ -0,0 +1,22 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cstdio>
+
+// The unit tests are plain executables: every failed check is reported on
+// stderr, and main() returns test_status().
+
+inline int test_failures = 0;
+
+inline void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        ++test_failures;
+    }
+}
+
+inline int test_status() {
+    return test_failures == 0 ? 0 : 1;
+}
+
+#endif // TESTS_CHECK_H
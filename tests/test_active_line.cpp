@@ -0,0 +1,92 @@
+// Cursor position relative to the wrap rows of an ActiveLine, which the
+// view walks from the first visible row; overwriting wide clusters and
+// UTF-8 split across writes.
+#include "active_line.h"
+#include "check.h"
+
+#include <string>
+
+namespace {
+
+void cursor_after_text() {
+    ActiveLine line;
+    line.write(std::string(25, 'a'), TerminalAttributes{});
+    check(line.rows(10) == 3, "25 cells wrap to 3 rows of 10");
+
+    auto last = line.row_start(10, 2);
+    check(last.cell == 20, "third row starts at cell 20");
+    check(line.cursor_offset(last) == 5u, "cursor is 5 cells into the last row");
+}
+
+void cursor_on_earlier_wrap_row() {
+    ActiveLine line;
+    line.write(std::string(25, 'a'), TerminalAttributes{});
+    line.carriage_return();
+    line.write("bb", TerminalAttributes{});
+    check(line.cursor() == 2, "cursor follows the overwrite");
+
+    // The view starts at the last row; the cursor is two rows above it
+    check(!line.cursor_offset(line.row_start(10, 2)),
+          "cursor before the first visible row has no offset");
+    check(line.cursor_offset(line.row_start(10, 0)) == 2u,
+          "cursor is 2 cells into the first row");
+}
+
+std::string text_of(const ActiveLine& line) {
+    std::string text;
+    for (const auto& seg : line.line().segments)
+        text += seg.content;
+    return text;
+}
+
+void overwriting_half_a_wide_cluster() {
+    const std::string wide = "\u4e2d";
+
+    // Second half: the first half is blanked, nothing after it moves
+    ActiveLine line;
+    line.write(wide + wide, TerminalAttributes{});
+    line.carriage_return();
+    line.move(1);
+    line.write("x", TerminalAttributes{});
+    check(text_of(line) == " x" + wide, "overwritten second half blanks the first");
+    check(line.length() == 4 && line.cursor() == 2, "cells keep their columns");
+
+    // First half: the second half is blanked
+    line.clear();
+    line.write("ab" + wide + "c", TerminalAttributes{});
+    line.carriage_return();
+    line.write("xyz", TerminalAttributes{});
+    check(text_of(line) == "xyz c", "overwritten first half blanks the second");
+    check(line.length() == 5, "line keeps its width");
+
+    // Erasing from the middle of one
+    line.clear();
+    line.write(wide + "a", TerminalAttributes{});
+    line.carriage_return();
+    line.move(1);
+    line.erase(0);
+    check(text_of(line) == " " && line.length() == 1, "erase blanks the half it keeps");
+}
+
+void utf8_split_across_writes() {
+    ActiveLine line;
+    line.write("a\xE4\xB8", TerminalAttributes{});
+    check(text_of(line) == "a" && line.length() == 1, "a cut-off sequence is held back");
+    line.write("\xAD" "b", TerminalAttributes{});
+    check(text_of(line) == "a\u4e2d" "b", "and finished by the next write");
+    check(line.length() == 4, "the finished character is wide");
+
+    line.clear();
+    line.write("\xFF", TerminalAttributes{});
+    check(text_of(line) == "\uFFFD", "malformed bytes become U+FFFD");
+}
+
+} // namespace
+
+int main() {
+    cursor_after_text();
+    cursor_on_earlier_wrap_row();
+    overwriting_half_a_wide_cluster();
+    utf8_split_across_writes();
+    return test_status();
+}
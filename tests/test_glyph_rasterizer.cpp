@@ -0,0 +1,60 @@
+// What the rasterizer leaves in the on-disk glyph cache. Needs a font:
+// SITA_TEST_FONT names one, and the test is skipped without it.
+#include "check.h"
+#include "glyph_disk_cache.h"
+#include "glyph_rasterizer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr unsigned PIXEL_SIZE = 38;
+constexpr unsigned GOOD_GLYPH = 36;
+constexpr unsigned BAD_GLYPH  = 0xFFFFFF;   // past any font's glyph count
+
+void failed_render_is_not_persisted(const std::shared_ptr<const FontFile>& font) {
+    {
+        GlyphRasterizer rasterizer(false, 1);
+        rasterizer.add_font(0, font, 0, PIXEL_SIZE);
+        rasterizer.request(0, GOOD_GLYPH);
+        rasterizer.request(0, BAD_GLYPH);
+
+        std::vector<GlyphBitmap> out;
+        rasterizer.drain(out);
+        check(out.size() == 2, "both requests are answered");
+        for (const GlyphBitmap& bitmap : out)
+            if (bitmap.glyph_id == BAD_GLYPH)
+                check(bitmap.pixels.empty(), "a failed render comes back blank");
+    }   // saves the disk cache
+
+    GlyphDiskCache cache;
+    check(cache.open(*font, 0, PIXEL_SIZE, false), "cache opens");
+    GlyphBitmap bitmap{};
+    check(cache.find(GOOD_GLYPH, bitmap), "a rendered glyph is persisted");
+    check(!cache.find(BAD_GLYPH, bitmap), "a failed render is not persisted");
+}
+
+} // namespace
+
+int main() {
+    const char* path = std::getenv("SITA_TEST_FONT");
+    std::shared_ptr<const FontFile> font = path ? FontFile::open(path) : nullptr;
+    if (!font) {
+        std::printf("skipped: set SITA_TEST_FONT to a font file\n");
+        return 77;
+    }
+
+    char dir[] = "/tmp/sita-test-XXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    setenv("XDG_CACHE_HOME", dir, 1);
+
+    failed_render_is_not_persisted(font);
+
+    std::filesystem::remove_all(dir);
+    return test_status();
+}
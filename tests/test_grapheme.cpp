@@ -0,0 +1,83 @@
+// Grapheme cluster boundaries (UAX #29) and the cell widths derived from
+// them.
+#include "check.h"
+#include "grapheme.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Clusters of `text`, each as its UTF-8 bytes.
+std::vector<std::string> clusters(std::string_view text) {
+    std::vector<std::string> out;
+    utl::GraphemeBreaker breaker;
+    for (size_t i = 0; i < text.size();) {
+        size_t at = i;
+        char32_t cp = utl::get_next_codepoint(text, i);
+        if (breaker.next(cp) || out.empty())
+            out.emplace_back();
+        out.back() += text.substr(at, i - at);
+    }
+    return out;
+}
+
+size_t count(std::string_view text) {
+    return clusters(text).size();
+}
+
+void marks_join_their_base() {
+    check(count("e\u0301") == 1, "combining acute joins e");
+    check(count("e\u0301\u0302x") == 2, "stacked marks stay with their base");
+    check(count("\u0301") == 1, "a lone mark is its own cluster");
+}
+
+void line_breaks() {
+    check(count("\r\n") == 1, "CR LF is one cluster");
+    check(count("\n\r") == 2, "LF CR is two");
+    check(count("\ra") == 2, "CR breaks from what follows");
+}
+
+void emoji_and_flags() {
+    // man ZWJ woman ZWJ girl
+    check(count("\U0001F468\u200D\U0001F469\u200D\U0001F467") == 1,
+          "ZWJ sequence is one cluster");
+    check(count("\U0001F44D\U0001F3FD") == 1, "skin tone modifier joins");
+    // N P, then a lone regional indicator
+    check(count("\U0001F1F3\U0001F1F5") == 1, "flag is one cluster");
+    check(count("\U0001F1F3\U0001F1F5\U0001F1F3") == 2, "regional indicators pair up");
+}
+
+void hangul_and_indic() {
+    check(count("\u1100\u1161\u11A8") == 1, "L V T jamo form one syllable");
+    check(count("\uAC00\u11A8") == 1, "LV syllable takes a trailing T");
+    // Devanagari ksha: consonant, virama, consonant (GB9c)
+    check(count("\u0915\u094D\u0937") == 1, "conjunct is one cluster");
+    // na ma sa-virama-ta-e: three clusters
+    check(count("\u0928\u092E\u0938\u094D\u0924\u0947") == 3, "namaste has three clusters");
+}
+
+void widths() {
+    check(utl::text_width("abc") == 3, "ASCII is one cell each");
+    check(utl::text_width("\u4E2D\u6587") == 4, "CJK is two cells each");
+    check(utl::text_width("e\u0301") == 1, "a mark adds nothing");
+    check(utl::text_width("\U0001F1F3\U0001F1F5") == 2, "a flag is two cells");
+    check(utl::text_width("\U0001F468\u200D\U0001F469") == 2, "a ZWJ sequence is two cells");
+
+    check(utl::appended_width("e", "\u0301") == 0, "mark appended to its base");
+    check(utl::appended_width("\U0001F1F3", "\U0001F1F5") == 1,
+          "second half of a flag widens it");
+    check(utl::appended_width("e", "\u0301x") == 1, "text after the mark counts");
+}
+
+} // namespace
+
+int main() {
+    marks_join_their_base();
+    line_breaks();
+    emoji_and_flags();
+    hangul_and_indic();
+    widths();
+    return test_status();
+}
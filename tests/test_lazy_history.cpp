@@ -0,0 +1,87 @@
+// LazyHistory: raw-byte history replayed on demand, with the unfinished
+// line kept up to date as bytes arrive.
+#include "check.h"
+#include "lazy_history.h"
+
+#include <string>
+
+namespace {
+
+std::string text_of(LineView line) {
+    std::string text;
+    for (SegmentView seg : line)
+        text += seg.content;
+    return text;
+}
+
+std::string text_of(const ActiveLine& line) {
+    std::string text;
+    for (const auto& seg : line.line().segments)
+        text += seg.content;
+    return text;
+}
+
+void append(LazyHistory& history, const std::string& text) {
+    history.append_text(text.data(), text.size(), TerminalAttributes{});
+}
+
+void lines_read_back() {
+    LazyHistory history;
+    for (int i = 0; i < 600; ++i)
+        append(history, "line " + std::to_string(i) + "\n");
+    append(history, "partial");
+
+    check(history.size() == 600, "every finished line is kept");
+    check(text_of(history[0]) == "line 0", "first line replays");
+    check(text_of(history[599]) == "line 599", "last line replays");
+    check(text_of(history.active()) == "partial", "unfinished line replays");
+}
+
+void active_line_follows_appends() {
+    LazyHistory history;
+    append(history, "done\n");
+    std::string expected;
+    for (int i = 0; i < 200; ++i) {
+        std::string piece = "chunk" + std::to_string(i) + " ";
+        append(history, piece);
+        expected += piece;
+        // Reading finished lines in between must not disturb it
+        if (i % 7 == 0)
+            check(text_of(history[0]) == "done", "finished line still reads back");
+        if (text_of(history.active()) != expected) {
+            check(false, "active line grows with each append");
+            return;
+        }
+    }
+
+    append(history, "\rover");
+    expected.replace(0, 4, "over");
+    check(text_of(history.active()) == expected, "carriage return overwrites");
+
+    append(history, "\nnext");
+    check(text_of(history.active()) == "next", "a new line starts empty");
+    check(text_of(history[1]) == expected, "and the old one is finished");
+}
+
+void compaction_keeps_the_active_line() {
+    LazyHistory history;
+    std::string shown;
+    for (int i = 0; i < 2000; ++i) {
+        shown = "progress " + std::to_string(i);
+        append(history, "\r" + shown);
+        history.compact_active(TerminalAttributes{});
+    }
+    check(history.usage().bytes < 64 << 10, "redrawn line stays small");
+    check(text_of(history.active()) == shown, "compacted line reads back");
+    append(history, " done");
+    check(text_of(history.active()) == shown + " done", "and keeps growing after it");
+}
+
+} // namespace
+
+int main() {
+    lines_read_back();
+    active_line_follows_appends();
+    compaction_keeps_the_active_line();
+    return test_status();
+}
@@ -0,0 +1,148 @@
+// LineBlock serialization against corrupt input, attribute ids past
+// 16 bits, and seeking into long lines.
+#include "check.h"
+#include "line_block.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+TerminalAttributes rgb_attributes(unsigned n) {
+    TerminalAttributes a;
+    a.foreground.type = TerminalColor::Type::RGB;
+    a.foreground.r = static_cast<uint8_t>(n);
+    a.foreground.g = static_cast<uint8_t>(n >> 8);
+    a.foreground.b = static_cast<uint8_t>(n >> 16);
+    return a;
+}
+
+ParsedLine line_with(unsigned n) {
+    ParsedLine line;
+    line.type = LineType::COMMAND_OUTPUT;
+    line.segments.push_back({"x", rgb_attributes(n)});
+    return line;
+}
+
+bool has_attributes(const LineBlock& block, size_t i, unsigned n) {
+    for (const SegmentView& seg : block[i])
+        return seg.attributes.foreground == rgb_attributes(n).foreground;
+    return false;
+}
+
+void huge_attribute_count_is_rejected() {
+    // A varint of 2^63 - 1 followed by nothing
+    std::string in(8, '\xFF');
+    in += '\x7F';
+    LineBlock out;
+    check(!LineBlock::deserialize(in, out), "huge attribute count rejected");
+}
+
+void truncated_blocks_are_rejected() {
+    LineBlock block;
+    for (unsigned n = 0; n < 50; ++n)
+        block.push_back(line_with(n));
+    std::string full = block.serialize();
+
+    LineBlock out;
+    check(LineBlock::deserialize(full, out), "full block reads back");
+    for (size_t len = 0; len < full.size(); ++len)
+        check(!LineBlock::deserialize(full.substr(0, len), out),
+              "truncated block rejected");
+}
+
+void attributes_past_16_bits_stay_distinct() {
+    constexpr unsigned LINES = 70000;
+    LineBlock block;
+    for (unsigned n = 0; n < LINES; ++n)
+        block.push_back(line_with(n));
+
+    check(has_attributes(block, 0, 0), "first attributes kept");
+    check(has_attributes(block, 65534, 65534), "attributes at 65534 kept");
+    check(has_attributes(block, LINES - 1, LINES - 1), "last attributes kept");
+
+    LineBlock copy;
+    check(LineBlock::deserialize(block.serialize(), copy), "wide block reads back");
+    check(copy.size() == LINES, "wide block keeps every line");
+    check(has_attributes(copy, LINES - 1, LINES - 1),
+          "last attributes survive serialization");
+}
+
+void repeated_attributes_share_an_id() {
+    // Far more distinct attributes than the recent-entry check covers, each
+    // coming back long after it was first seen
+    constexpr unsigned DISTINCT = 1000;
+    LineBlock block;
+    for (int pass = 0; pass < 3; ++pass)
+        for (unsigned n = 0; n < DISTINCT; ++n)
+            block.push_back(line_with(n));
+
+    // The serialized form starts with the attribute count as a varint
+    std::string out = block.serialize();
+    size_t count = (static_cast<uint8_t>(out[0]) & 0x7F) |
+                   static_cast<size_t>(static_cast<uint8_t>(out[1])) << 7;
+    check(count == DISTINCT, "each attribute set is stored once");
+    check(has_attributes(block, 2 * DISTINCT + 7, 7), "repeats resolve to their set");
+}
+
+// Runs of 1000 ASCII cells, every other one followed by 100 wide
+// characters; `starts` gets the cells before each run.
+ParsedLine long_line(std::vector<size_t>& starts) {
+    ParsedLine line;
+    line.type = LineType::COMMAND_OUTPUT;
+    size_t cells = 0;
+    for (unsigned k = 0; k < 40; ++k) {
+        std::string text(1000, static_cast<char>('a' + k % 26));
+        size_t width = 1000;
+        if (k % 2) {
+            for (int i = 0; i < 100; ++i)
+                text += "\u4e2d";
+            width += 200;
+        }
+        starts.push_back(cells);
+        cells += width;
+        line.segments.push_back({text, rgb_attributes(k)});
+    }
+    return line;
+}
+
+bool seeks_into(const LineBlock& block, const std::vector<size_t>& starts) {
+    LineView line = block[1];
+    for (size_t k = 0; k < starts.size(); ++k) {
+        for (size_t cell : {starts[k], starts[k] + 1, starts[k] + 999}) {
+            size_t run_cell = 99;
+            auto it = line.seek(cell, run_cell);
+            if (run_cell != starts[k] ||
+                (*it).attributes.foreground != rgb_attributes(static_cast<unsigned>(k)).foreground)
+                return false;
+        }
+    }
+    return true;
+}
+
+void long_lines_seek_to_a_run() {
+    std::vector<size_t> starts;
+    LineBlock block;
+    block.push_back(line_with(1));
+    block.push_back(long_line(starts));
+
+    size_t run_cell = 99;
+    check(block[0].seek(5, run_cell) == block[0].begin() && run_cell == 0,
+          "short lines start from the beginning");
+    check(seeks_into(block, starts), "long lines start at the run holding the cell");
+
+    LineBlock copy;
+    check(LineBlock::deserialize(block.serialize(), copy), "long line reads back");
+    check(seeks_into(copy, starts), "run positions are rebuilt on decode");
+}
+
+} // namespace
+
+int main() {
+    huge_attribute_count_is_rejected();
+    truncated_blocks_are_rejected();
+    attributes_past_16_bits_stay_distinct();
+    repeated_attributes_share_an_id();
+    long_lines_seek_to_a_run();
+    return test_status();
+}
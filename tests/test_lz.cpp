@@ -0,0 +1,103 @@
+// Round trips through the scrollback codec, and the decoder against
+// truncated and corrupt blocks, which it reads from disk.
+#include "check.h"
+#include "lz.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> samples() {
+    std::mt19937 rng(42);
+    std::string noise(5000, '\0');
+    for (char& c : noise)
+        c = static_cast<char>(rng());
+
+    std::string log;
+    for (int i = 0; i < 2000; ++i)
+        log += "[" + std::to_string(i) + "] build step finished\n";
+
+    return {
+        "",
+        "a",
+        "abcdefghijklm",                          // just past the match limit
+        std::string(100000, 'x'),                 // one long overlapping match
+        std::string(300, 'y') + noise,            // long literal run after it
+        noise,
+        log,
+        log + noise + log,                        // a repeat from far back
+    };
+}
+
+void round_trips() {
+    for (const std::string& in : samples()) {
+        std::vector<uint8_t> packed = lz::compress(in);
+        std::string out;
+        check(lz::decompress(packed.data(), packed.size(), out, in.size()),
+              "sample decompresses");
+        check(out == in, "sample round-trips");
+    }
+
+    std::string repeated(100000, 'x');
+    check(lz::compress(repeated).size() < 1000, "repetitive input shrinks");
+}
+
+void truncated_input_is_rejected() {
+    for (const std::string& in : samples()) {
+        if (in.empty())
+            continue;
+        std::vector<uint8_t> packed = lz::compress(in);
+        std::string out;
+        for (size_t len = 0; len < packed.size(); len += 1 + len / 16)
+            check(!lz::decompress(packed.data(), len, out, in.size()),
+                  "truncated block rejected");
+    }
+}
+
+void wrong_size_is_rejected() {
+    std::string in = samples()[6];
+    std::vector<uint8_t> packed = lz::compress(in);
+    std::string out;
+    check(!lz::decompress(packed.data(), packed.size(), out, in.size() - 1),
+          "block longer than expected rejected");
+    check(!lz::decompress(packed.data(), packed.size(), out, in.size() + 1),
+          "block shorter than expected rejected");
+}
+
+void corrupt_input_is_contained() {
+    // Whatever the bytes, decoding stays within the input and raw_size
+    std::mt19937 rng(7);
+    std::string in = samples()[6];
+    std::vector<uint8_t> packed = lz::compress(in);
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<uint8_t> bad = packed;
+        for (int flips = 0; flips < 4; ++flips)
+            bad[rng() % bad.size()] = static_cast<uint8_t>(rng());
+        std::string out;
+        if (!lz::decompress(bad.data(), bad.size(), out, in.size()))
+            continue;
+        check(out.size() == in.size(), "accepted block has the expected size");
+    }
+
+    // A match reaching back before the start of the output
+    std::vector<uint8_t> before_start = {0x10, 'a', 0x05, 0x00, 0x00};
+    std::string out;
+    check(!lz::decompress(before_start.data(), before_start.size(), out, 100),
+          "offset past the output rejected");
+
+    std::vector<uint8_t> zero_offset = {0x10, 'a', 0x00, 0x00, 0x00};
+    check(!lz::decompress(zero_offset.data(), zero_offset.size(), out, 100),
+          "zero offset rejected");
+}
+
+} // namespace
+
+int main() {
+    round_trips();
+    truncated_input_is_rejected();
+    wrong_size_is_rejected();
+    corrupt_input_is_contained();
+    return test_status();
+}
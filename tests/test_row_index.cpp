@@ -0,0 +1,232 @@
+// RowIndex: visual rows of history lines at a width, wrapped the way the
+// renderer wraps them, kept up to date as lines are appended and evicted.
+#include "check.h"
+#include "row_index.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using WideRun = RowIndex::WideRun;
+
+// Cells where each row of a line starts, laid out one cluster at a time
+// the way the renderer does.
+std::vector<size_t> row_starts(const std::vector<size_t>& widths, size_t cols) {
+    std::vector<size_t> starts = {0};
+    size_t used = 0;
+    size_t cell = 0;
+    for (size_t w : widths) {
+        if (used > 0 && used + w > cols) {
+            starts.push_back(cell);
+            used = 0;
+        }
+        used += w;
+        cell += w;
+    }
+    return starts;
+}
+
+std::vector<WideRun> wide_runs(const std::vector<size_t>& widths) {
+    std::vector<WideRun> runs;
+    uint32_t cell = 0;
+    for (size_t w : widths) {
+        if (w == 2) {
+            if (!runs.empty() && runs.back().cell + 2 * runs.back().count == cell)
+                ++runs.back().count;
+            else
+                runs.push_back({cell, 1});
+        }
+        cell += static_cast<uint32_t>(w);
+    }
+    return runs;
+}
+
+// Rows before every line, counted the slow way.
+std::vector<size_t> expected_starts(const std::vector<size_t>& cells, size_t cols) {
+    std::vector<size_t> starts;
+    size_t row = 0;
+    for (size_t c : cells) {
+        starts.push_back(row);
+        row += RowIndex::rows_for(c, cols);
+    }
+    starts.push_back(row);
+    return starts;
+}
+
+bool agrees(const RowIndex& index, const std::vector<size_t>& cells, size_t cols) {
+    std::vector<size_t> starts = expected_starts(cells, cols);
+    if (index.size() != cells.size() || index.total(cols) != starts.back())
+        return false;
+    for (size_t line = 0; line < cells.size(); ++line) {
+        if (index.rows_before(cols, line) != starts[line])
+            return false;
+        size_t rows = starts[line + 1] - starts[line];
+        for (size_t sub = 0; sub < rows; ++sub)
+            if (index.locate(cols, starts[line] + sub) != std::pair{line, sub})
+                return false;
+    }
+    return index.locate(cols, starts.back()) == std::pair{cells.size(), size_t{0}};
+}
+
+void rows_for_wraps_by_width() {
+    check(RowIndex::rows_for(0, 80) == 1, "an empty line takes a row");
+    check(RowIndex::rows_for(80, 80) == 1, "a full row fits");
+    check(RowIndex::rows_for(81, 80) == 2, "one more cell wraps");
+}
+
+void wide_clusters_wrap_early() {
+    // "abc" then a wide character at the wrap column of a 4-column row
+    RowIndex::LineCells line;
+    line.add("abc\u4e2d\u4e2dd");
+    check(line.cells() == 8, "wide characters take two cells");
+    check(line.wide().size() == 1 && line.wide()[0].cell == 3 && line.wide()[0].count == 2,
+          "adjacent wide characters form one run");
+
+    RowIndex index;
+    index.push_back(line);
+    check(index.rows_at(0, 4) == 3, "a wide character does not straddle the last column");
+    check(index.total(4) == 3 && index.locate(4, 2) == std::pair{size_t{0}, size_t{2}},
+          "the tree counts the early wrap");
+    check(index.row_start(0, 4, 1) == 3 && index.row_start(0, 4, 2) == 7,
+          "rows start where the renderer starts them");
+    check(index.rows_at(0, 8) == 1, "the line fits a wide row");
+    check(index.rows_at(0, 1) == 6, "one column: every wide character on its own row");
+}
+
+void layout_matches_renderer() {
+    std::mt19937 rng(7);
+    for (int round = 0; round < 2000; ++round) {
+        std::vector<size_t> widths(rng() % 40);
+        for (size_t& w : widths)
+            w = rng() % 3 == 0 ? 2 : 1;
+        size_t cells = 0;
+        for (size_t w : widths)
+            cells += w;
+
+        std::vector<WideRun> runs = wide_runs(widths);
+        for (size_t cols = 1; cols <= 9; ++cols) {
+            std::vector<size_t> starts = row_starts(widths, cols);
+            if (RowIndex::layout(cells, runs, cols) != starts.size()) {
+                check(false, "row count matches a cluster-by-cluster layout");
+                return;
+            }
+            for (size_t row = 0; row <= starts.size(); ++row) {
+                size_t start = 0;
+                RowIndex::layout(cells, runs, cols, row, &start);
+                if (start != (row < starts.size() ? starts[row] : cells)) {
+                    check(false, "row starts match a cluster-by-cluster layout");
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void wide_lines_survive_compaction() {
+    RowIndex index;
+    std::vector<std::vector<size_t>> lines;
+    for (size_t i = 0; i < 10000; ++i) {
+        std::vector<size_t> widths(i % 23, 1);
+        if (i % 3 == 0)
+            widths.insert(widths.end(), i % 7, 2);
+        widths.push_back(1);
+        size_t cells = 0;
+        for (size_t w : widths)
+            cells += w;
+        index.push_back(cells, wide_runs(widths));
+        lines.push_back(widths);
+    }
+    index.total(6);
+    for (size_t i = 0; i < 6000; ++i)
+        index.pop_front();
+    lines.erase(lines.begin(), lines.begin() + 6000);
+
+    bool ok = index.size() == lines.size();
+    for (size_t cols : {size_t{6}, size_t{5}}) {
+        size_t total = 0;
+        for (size_t line = 0; ok && line < lines.size(); ++line) {
+            size_t rows = row_starts(lines[line], cols).size();
+            ok = index.rows_at(line, cols) == rows && index.rows_before(cols, line) == total;
+            total += rows;
+        }
+        ok = ok && index.total(cols) == total;
+    }
+    check(ok, "wide runs follow their lines through compaction");
+}
+
+void locate_and_count() {
+    RowIndex index;
+    std::vector<size_t> cells = {0, 5, 80, 81, 200, 1, 160};
+    for (size_t c : cells)
+        index.push_back(c);
+
+    check(agrees(index, cells, 80), "queries match at 80 columns");
+    check(agrees(index, cells, 7), "queries match at 7 columns");
+    check(agrees(index, cells, 1), "queries match at 1 column");
+
+    // Appends after the tree is built extend it
+    index.push_back(300);
+    cells.push_back(300);
+    check(agrees(index, cells, 7), "appended line is counted");
+}
+
+void eviction_and_compaction() {
+    RowIndex index;
+    std::vector<size_t> cells;
+    for (size_t i = 0; i < 20000; ++i) {
+        index.push_back(i % 250);
+        cells.push_back(i % 250);
+    }
+    check(index.total(40) == expected_starts(cells, 40).back(), "tree built");
+
+    // Enough to compact the dead front slots more than once
+    for (size_t i = 0; i < 15000; ++i)
+        index.pop_front();
+    cells.erase(cells.begin(), cells.begin() + 15000);
+    check(agrees(index, cells, 40), "queries match after eviction");
+    check(agrees(index, cells, 33), "and at a new width");
+    check(index.memory() == 5000 * (sizeof(uint32_t) + sizeof(uint64_t)),
+          "memory follows the live lines");
+
+    index.clear();
+    check(index.empty() && index.total(40) == 0, "clear empties the index");
+}
+
+void background_rebuild() {
+    RowIndex index;
+    std::vector<size_t> cells;
+    for (size_t i = 0; i < RowIndex::BACKGROUND_MIN_LINES + 1000; ++i) {
+        index.push_back(i % 97);
+        cells.push_back(i % 97);
+    }
+    check(!index.ready(80), "a large index is rebuilt in the background");
+
+    // Changes made meanwhile are replayed onto the finished tree
+    for (size_t i = 0; i < 500; ++i) {
+        index.pop_front();
+        index.push_back(i % 300);
+        cells.push_back(i % 300);
+    }
+    cells.erase(cells.begin(), cells.begin() + 500);
+
+    for (int wait = 0; wait < 1000 && !index.ready(80); ++wait)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    check(index.ready(80), "background rebuild finishes");
+    check(agrees(index, cells, 80), "queries match after the rebuild");
+}
+
+} // namespace
+
+int main() {
+    rows_for_wraps_by_width();
+    wide_clusters_wrap_early();
+    layout_matches_renderer();
+    wide_lines_survive_compaction();
+    locate_and_count();
+    eviction_and_compaction();
+    background_rebuild();
+    return test_status();
+}
@@ -0,0 +1,119 @@
+// Scrollback eviction by line and byte limits, with hot, compressed and
+// disk-backed blocks.
+#include "check.h"
+#include "scrollback.h"
+
+#include <string>
+
+namespace {
+
+ParsedLine line_with(const std::string& text) {
+    ParsedLine line;
+    line.type = LineType::COMMAND_OUTPUT;
+    line.segments.push_back({text, TerminalAttributes{}});
+    return line;
+}
+
+std::string text_of(LineView line) {
+    std::string text;
+    for (SegmentView seg : line)
+        text += seg.content;
+    return text;
+}
+
+std::string numbered(size_t i) {
+    return "line " + std::to_string(i);
+}
+
+void line_limit_drops_oldest_lines() {
+    Scrollback history(300, 0);
+    for (size_t i = 0; i < 1000; ++i)
+        history.push_back(line_with(numbered(i)));
+
+    check(history.size() == 300, "line limit holds");
+    check(text_of(history[0]) == numbered(700), "oldest kept line is the 300th newest");
+    check(text_of(history[299]) == numbered(999), "newest line kept");
+    check(history.rows().size() == 300, "row index follows evictions");
+}
+
+void byte_limit_drops_oldest_lines() {
+    constexpr size_t LIMIT = 256 << 10;
+    Scrollback history(0, LIMIT);
+    history.set_cold_after(0);   // keep every block hot so sizes add up fast
+    std::string filler(200, 'x');
+    for (size_t i = 0; i < 20000; ++i)
+        history.push_back(line_with(numbered(i) + filler));
+
+    check(history.usage().bytes <= LIMIT, "byte limit holds");
+    check(history.size() > 0 && history.size() < 20000, "some lines evicted");
+    check(text_of(history[history.size() - 1]) == numbered(19999) + filler,
+          "newest line kept");
+}
+
+void newest_line_survives_a_tiny_byte_limit() {
+    Scrollback history(0, 1);
+    history.push_back(line_with("first"));
+    history.push_back(line_with("second"));
+    check(history.size() == 1, "only the newest line is kept");
+    check(text_of(history[0]) == "second", "it is the newest");
+}
+
+void cold_blocks_read_back() {
+    Scrollback history(0, 0);
+    history.set_cold_after(1);
+    constexpr size_t LINES = Scrollback::BLOCK_LINES * 6;
+    for (size_t i = 0; i < LINES; ++i)
+        history.push_back(line_with(numbered(i)));
+
+    check(history.usage().cold_blocks >= 4, "old blocks are compressed");
+    for (size_t i = 0; i < LINES; i += 97)
+        check(text_of(history[i]) == numbered(i), "compressed line reads back");
+}
+
+void spilled_blocks_read_back_and_evict() {
+    Scrollback history(Scrollback::BLOCK_LINES * 3, 0);
+    history.set_cold_after(1);
+    if (!history.enable_disk_backing()) {
+        check(false, "disk backing opens");
+        return;
+    }
+    constexpr size_t LINES = Scrollback::BLOCK_LINES * 8;
+    for (size_t i = 0; i < LINES; ++i)
+        history.push_back(line_with(numbered(i)));
+
+    check(history.size() == Scrollback::BLOCK_LINES * 3, "line limit holds on disk");
+    size_t first = LINES - history.size();
+    for (size_t i = 0; i < history.size(); i += 101)
+        check(text_of(history[i]) == numbered(first + i), "spilled line reads back");
+}
+
+void disk_backed_history_counts_the_row_index() {
+    // Unlimited lines, as with SITA_SCROLLBACK_FILE: only the resident
+    // bookkeeping bounds the history.
+    constexpr size_t LIMIT = 256 << 10;
+    Scrollback history(0, LIMIT);
+    history.set_cold_after(1);
+    if (!history.enable_disk_backing()) {
+        check(false, "disk backing opens");
+        return;
+    }
+    for (size_t i = 0; i < 200000; ++i)
+        history.push_back(line_with(numbered(i)));
+
+    check(history.rows().memory() > 0, "the row index has a size");
+    check(history.usage().bytes >= history.rows().memory(), "usage counts the row index");
+    check(history.usage().bytes <= LIMIT, "byte limit holds with text on disk");
+    check(history.size() < 200000, "old lines evicted");
+}
+
+} // namespace
+
+int main() {
+    line_limit_drops_oldest_lines();
+    byte_limit_drops_oldest_lines();
+    newest_line_survives_a_tiny_byte_limit();
+    cold_blocks_read_back();
+    spilled_blocks_read_back_and_evict();
+    disk_backed_history_counts_the_row_index();
+    return test_status();
+}
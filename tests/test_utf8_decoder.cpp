@@ -0,0 +1,90 @@
+// The streaming UTF-8 decoder: sequences split across reads, and malformed
+// input replaced one maximal subpart at a time.
+#include "check.h"
+#include "utf8_decoder.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using Points = std::vector<char32_t>;
+
+constexpr char32_t FFFD = utl::Utf8Decoder::REPLACEMENT;
+
+Points decode(std::string_view bytes) {
+    utl::Utf8Decoder decoder;
+    Points out;
+    decoder.feed(bytes, [&](char32_t cp, std::string_view) { out.push_back(cp); });
+    return out;
+}
+
+void splits_anywhere_decode_alike() {
+    // ASCII, 2-, 3- and 4-byte sequences back to back
+    std::string text = "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80z";
+    Points whole = decode(text);
+    check(whole == Points{'a', 0xE9, 0x4E2D, 0x1F600, 'z'}, "whole input decodes");
+
+    for (size_t cut = 0; cut <= text.size(); ++cut) {
+        for (size_t cut2 = cut; cut2 <= text.size(); ++cut2) {
+            utl::Utf8Decoder decoder;
+            Points out;
+            auto emit = [&](char32_t cp, std::string_view) { out.push_back(cp); };
+            decoder.feed(std::string_view(text).substr(0, cut), emit);
+            decoder.feed(std::string_view(text).substr(cut, cut2 - cut), emit);
+            decoder.feed(std::string_view(text).substr(cut2), emit);
+            check(out == whole, "input split in three decodes the same");
+            check(decoder.pending() == 0, "nothing left pending");
+        }
+    }
+}
+
+void unfinished_sequence_is_held() {
+    utl::Utf8Decoder decoder;
+    Points out;
+    auto emit = [&](char32_t cp, std::string_view) { out.push_back(cp); };
+    decoder.feed("\xE4\xB8", emit);
+    check(out.empty() && decoder.pending() == 2, "partial sequence waits");
+    decoder.feed("\xAD", emit);
+    check(out == Points{0x4E2D}, "and finishes on the next read");
+}
+
+void malformed_input_is_replaced() {
+    check(decode("\x80") == Points{FFFD}, "lone continuation byte");
+    check(decode("\xC0\x80") == Points{FFFD, FFFD}, "overlong lead and its tail");
+    check(decode("\xE4\xB8" "A") == Points{FFFD, 'A'}, "sequence cut short by ASCII");
+    check(decode("\xED\xA0\x80") == Points{FFFD, FFFD, FFFD}, "surrogate");
+    check(decode("\xF4\x90\x80\x80") == Points{FFFD, FFFD, FFFD, FFFD},
+          "past U+10FFFF");
+    check(decode("\xF5") == Points{FFFD}, "invalid lead byte");
+
+    // Split at the break, the replacement comes when the next byte arrives
+    utl::Utf8Decoder decoder;
+    Points out;
+    auto emit = [&](char32_t cp, std::string_view) { out.push_back(cp); };
+    decoder.feed("\xE4", emit);
+    decoder.feed("B", emit);
+    check(out == Points{FFFD, 'B'}, "broken sequence across reads");
+}
+
+void ascii_runs_are_measured() {
+    std::string text(100, 'x');
+    check(utl::ascii_prefix(text.data(), text.size()) == 100, "all ASCII");
+    for (size_t at : {0, 1, 7, 8, 15, 16, 63, 99}) {
+        std::string mixed = text;
+        mixed[at] = '\xC3';
+        check(utl::ascii_prefix(mixed.data(), mixed.size()) == at,
+              "run stops at the first non-ASCII byte");
+    }
+}
+
+} // namespace
+
+int main() {
+    splits_anywhere_decode_alike();
+    unfinished_sequence_is_held();
+    malformed_input_is_replaced();
+    ascii_runs_are_measured();
+    return test_status();
+}